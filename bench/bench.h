@@ -0,0 +1,39 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+//zero sleep build of the parks for measuring the locking protocol, see bench/run.sh
+//built with -DBENCH the model delays (explore, ticket, boarding, ride) only yield, so the run is all synchronization
+//the wall clock run length (-d) and the car load timeout still use real time
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+
+#ifdef BENCH
+
+static inline void model_sleep(int seconds) {
+    (void)seconds;
+    sched_yield();
+}
+
+//one line on stderr, stdout is left to the park's own log
+static inline void bench_report(const char* part, int passengers, int cars, long rides, long boardings,
+                                long tickets, double seconds) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long switches = usage.ru_nvcsw + usage.ru_nivcsw;
+    fprintf(stderr, "%s %d %d %.0f %.0f %.0f %.1f\n", part, passengers, cars,
+            rides / seconds, boardings / seconds, tickets / seconds,
+            rides ? (double)switches / rides : 0);
+}
+
+#else
+
+static inline void model_sleep(int seconds) {
+    sleep(seconds);
+}
+
+#endif
+
+#endif
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Side by side benchmark of the three parks' synchronization, run by "make bench" at the top level.
+# Each part is built with -DBENCH so the model sleeps only yield, then run for SECONDS at every passenger count.
+# Park output goes to /dev/null, each run reports one line on stderr that is collected into the table.
+
+SECONDS_PER_RUN=${SECONDS_PER_RUN:-2}
+THREADS=${THREADS:-"1 2 4 8 16 32 64"}
+CARS=${CARS:-2}
+CAPACITY=${CAPACITY:-5}
+
+cd "$(dirname "$0")/.." || exit 1
+
+printf "%-6s %10s %5s %12s %12s %12s %12s\n" part passengers cars rides/s boardings/s tickets/s csw/ride
+for n in $THREADS; do
+    for part in part1 part2 part3; do
+        case $part in
+            part1) args="-n $n -d $SECONDS_PER_RUN" ;;
+            part2) args="-n $n -c $CARS -p $CAPACITY -w 1 -d $SECONDS_PER_RUN" ;;
+            part3) args="-n $n -c $CARS -p $CAPACITY -w 1 -l $CARS -b $CARS -d $SECONDS_PER_RUN -L 0" ;;
+        esac
+        line=$(./$part/park_bench $args 2>&1 >/dev/null | tail -n 1)
+        set -- $line
+        printf "%-6s %10s %5s %12s %12s %12s %12s\n" "$1" "$2" "$3" "$4" "$5" "$6" "$7"
+    done
+done
@@ -4,15 +4,19 @@
 #include <unistd.h>
 #include <pthread.h>
 #include <time.h>
+#include <getopt.h>
+#include "../bench/bench.h"
 
 //single threaded version
 //explore (sleep) -> get ticket (mutex protected) -> wait for car -> board car -> ride(sleep) -> unboard -> repeat or exit
 //pthread_create, pthread_join, pthread_exit
 //mutexes/locks protect shared data
+//built with -DBENCH (make park_bench) the sleeps only yield and main runs waves of passengers for -d seconds
 
 //ticket (mutex) and time
 pthread_mutex_t ticket_mutex = PTHREAD_MUTEX_INITIALIZER;
 static struct timespec start_time;
+long tickets_sold = 0; //guarded by ticket_mutex
 
 //timestamp printer
 void print_time(){
@@ -30,7 +34,7 @@ void explore_park (int id){
     int explore_time = rand() % 10 + 1; //random time exploring
     print_time();
     printf("Passenger %d is exploring the park for %d seconds!\n", id, explore_time);
-    sleep(explore_time); //sleeping for amount in the park
+    model_sleep(explore_time); //sleeping for amount in the park
 }
 
 //getting ticket (mutex)!
@@ -38,7 +42,8 @@ void get_ticket(int id){
     pthread_mutex_lock(&ticket_mutex); //locking for critical section (ticket)
     print_time();
     printf("Passenger %d is getting ticket!\n", id);
-    sleep(1); //waiting to get ticket
+    model_sleep(1); //waiting to get ticket
+    tickets_sold++;
     print_time();
     printf("Passenger %d has gotten ticket!\n", id);
     pthread_mutex_unlock(&ticket_mutex); //have to unlock mutex when you lock it
@@ -48,7 +53,7 @@ void get_ticket(int id){
 void board_car(int id){
     print_time();
     printf("Passenger %d is waiting to board car!", id);
-    sleep(2); //waiting to board
+    model_sleep(2); //waiting to board
     print_time();
     printf("Passenger %d has boarded the car!\n", id);
 }
@@ -58,7 +63,7 @@ void ride_car(int id){
     int ride_time = rand() % 3 + 3; //random ride time from 3 - 5 seconds
     print_time();
     printf("Passenger %d is on the ride for %d seconds!", id, ride_time);
-    sleep(ride_time); //to replicate being on the ride
+    model_sleep(ride_time); //to replicate being on the ride
     print_time();
     printf("Passenger %d's ride is over!", id);
 }
@@ -84,15 +89,61 @@ void* passenger_thread(void *arg){
     return NULL;
 }
 
-int main(){
+int main(int argc, char* argv[]){
     srand(time(NULL));
     clock_gettime(CLOCK_REALTIME, &start_time);
 
+#ifdef BENCH
+    //-n passengers at a time, new waves until -d seconds are up
+    int passengers = 1, seconds = 2, opt;
+    while ((opt = getopt(argc, argv, "n:d:")) != -1) {
+        if (opt == 'n') passengers = atoi(optarg);
+        if (opt == 'd') seconds = atoi(optarg);
+    }
+    if (passengers < 1 || seconds < 1) {
+        fprintf(stderr, "Usage: %s [-n passengers] [-d seconds], both at least 1\n", argv[0]);
+        return 1;
+    }
+    pthread_t* threads = malloc(sizeof(pthread_t) * passengers);
+    int* ids = malloc(sizeof(int) * passengers);
+    if (!threads || !ids) {
+        perror("malloc");
+        return 1;
+    }
+    long rides = 0;
+    struct timespec now;
+    do {
+        //only the passengers that got a thread ride
+        int started = 0;
+        for (int i = 0; i < passengers; ++i) {
+            ids[i] = i + 1;
+            if (pthread_create(&threads[started], NULL, passenger_thread, &ids[i]) == 0) {
+                started++;
+            }
+        }
+        if (started == 0) {
+            fprintf(stderr, "cannot start any passenger threads\n");
+            return 1;
+        }
+        for (int i = 0; i < started; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        rides += started;
+        clock_gettime(CLOCK_REALTIME, &now);
+    } while (now.tv_sec - start_time.tv_sec < seconds);
+    free(threads);
+    free(ids);
+    double elapsed = (now.tv_sec - start_time.tv_sec) + (now.tv_nsec - start_time.tv_nsec) / 1e9;
+    bench_report("part1", passengers, 0, rides, rides, tickets_sold, elapsed);
+#else
+    (void)argc;
+    (void)argv;
     pthread_t passenger;
     int id = 1;
 
     pthread_create(&passenger, NULL, passenger_thread, &id);
     pthread_join(passenger, NULL);
+#endif
 
     print_time();
     printf("Simulation complete\n");
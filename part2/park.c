@@ -6,6 +6,7 @@
 #include <errno.h>
 #include <time.h>
 #include <getopt.h>
+#include "../bench/bench.h"
 
 #define MAX_CAPACITY 100
 //multi threaded version
@@ -17,6 +18,7 @@
 //multiple cars can be running at the same time
 //pthread_create, pthread_join, pthread_exit
 //mutexes/locks protect shared data
+//built with -DBENCH (make park_bench) the explore/ticket/ride sleeps only yield, -d sets the run length
 
 //settings
 int NUM_PASSENGERS = 10;
@@ -24,10 +26,14 @@ int NUM_CARS = 1;
 int CAR_CAPACITY = 5;
 int WAIT_SECONDS = 8;
 int RIDE_SECONDS = 6;
+int SIM_SECONDS = 10;
 
 //ticket (mutex) and time
 pthread_mutex_t ticket_mutex = PTHREAD_MUTEX_INITIALIZER;
 static struct timespec start_time;
+long tickets_sold = 0; //guarded by ticket_mutex
+long rides_run = 0; //guarded by state.mutex
+long boardings = 0; //guarded by state.mutex
 
 //park state
 typedef struct{
@@ -70,13 +76,14 @@ void* passenger_thread(void* arg) {
         int explore_time = rand() % 5 + 1;
         print_time();
         printf("Paassenger %d exploring for %d seconds! \n", id, explore_time);
-        sleep(explore_time); //similar logic to part 1
+        model_sleep(explore_time); //similar logic to part 1
 
         //get ticket ... use mutex lock and unlock
         pthread_mutex_lock(&ticket_mutex);
         print_time();
         printf("Passenger %d getting ticket! \n", id);
-        sleep(1);
+        model_sleep(1);
+        tickets_sold++;
         pthread_mutex_unlock(&ticket_mutex);
         print_time();
         printf("Passenger %d got ticket! \n", id);
@@ -91,6 +98,7 @@ void* passenger_thread(void* arg) {
             break;
         }
         state.passengers_boarded++;
+        boardings++;
         print_time();
         printf("Passenger %d boarded car %d (%d/%d) \n", id, state.car_id, state.passengers_boarded, CAR_CAPACITY);
         if (state.passengers_boarded >= CAR_CAPACITY){
@@ -166,7 +174,10 @@ void* car_thread(void* arg) {
         // Ride
         print_time();
         printf("[Car %d] Running ride...\n", id);
-        sleep(RIDE_SECONDS); //sleep for amount on ride
+        pthread_mutex_lock(&state.mutex);
+        rides_run++;
+        pthread_mutex_unlock(&state.mutex);
+        model_sleep(RIDE_SECONDS); //sleep for amount on ride
 
         // Unload
         pthread_mutex_lock(&state.mutex);
@@ -195,14 +206,15 @@ int main(int argc, char* argv[]) {
     
     // parse flags
     int opt;
-    while ((opt = getopt(argc, argv, "n:c:p:w:r:")) != -1) {
+    while ((opt = getopt(argc, argv, "n:c:p:w:r:d:")) != -1) {
         switch (opt) {
             case 'n': NUM_PASSENGERS = atoi(optarg); break;
             case 'c': NUM_CARS = atoi(optarg); break;
             case 'p': CAR_CAPACITY = atoi(optarg); break;
             case 'w': WAIT_SECONDS = atoi(optarg); break;
             case 'r': RIDE_SECONDS = atoi(optarg); break;
-            default: fprintf(stderr, "Usage: %s -n num_passengers -c num_cars -p capacity -w wait -r ride\n", argv[0]); 
+            case 'd': SIM_SECONDS = atoi(optarg); break;
+            default: fprintf(stderr, "Usage: %s -n num_passengers -c num_cars -p capacity -w wait -r ride [-d seconds]\n", argv[0]); 
                      exit(1);
         }
     }
@@ -232,7 +244,7 @@ int main(int argc, char* argv[]) {
         pthread_create(&passenger_threads[i], NULL, passenger_thread, id);
     }
 
-    sleep(10); // run for 10 seconds
+    sleep(SIM_SECONDS); // run for 10 seconds by default
     
     pthread_mutex_lock(&state.mutex);
     state.running = 0; // signal threads to exit
@@ -257,6 +269,12 @@ int main(int argc, char* argv[]) {
 
     print_time();
     printf("Simulation ended!\n");
+#ifdef BENCH
+    struct timespec end;
+    clock_gettime(CLOCK_REALTIME, &end);
+    bench_report("part2", NUM_PASSENGERS, NUM_CARS, rides_run, boardings, tickets_sold,
+                 (end.tv_sec - start_time.tv_sec) + (end.tv_nsec - start_time.tv_nsec) / 1e9);
+#endif
     return 0;
 }
 
@@ -0,0 +1,291 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "park.h"
+#include "stats.h"
+#include "log.h"
+#include "trace.h"
+
+//park-analyze, recomputes the end of day statistics from a --trace file
+//the trace is mapped, not read, so a trace of hundreds of millions of events costs no heap, only a few words per passenger and car
+//waits are rebuilt from pairs of records: ticket wait from the end of exploring to the ticket, ride wait from the ticket to boarding,
+//car load from loading to running, car idle from unloading (or opening) to loading
+//--from/--to count only what ends inside the window, --passenger/--car only what that passenger or car did
+//a pair whose records came out of order (see trace.h) is dropped, every exploring or unloading record starts a fresh one
+
+typedef struct {
+    int64_t joined; // joined the ticket line, -1 if not waiting
+    int64_t served; // reached a booth
+    int64_t got;    // got a ticket, waiting for a car
+    int booth;
+} PassengerTrack;
+
+typedef struct {
+    int64_t idle_since;
+    int64_t loading_since;
+    int boarded;
+    int capacity;
+} CarTrack;
+
+typedef struct {
+    int64_t from, to;
+    int passenger; // 0 for all
+    int car;
+} Filter;
+
+static PassengerTrack* passengers = NULL;
+static int num_passengers = 0;
+static CarTrack* cars = NULL;
+static int num_cars = 0;
+static BoothStats* booths = NULL;
+static int num_booths = 0;  // allocated
+static int booths_seen = 0; // highest booth number in the trace
+static long dropped = 0;    // pairs whose end came before their start
+
+//grows an array of tracks to hold 1-based id, new slots are filled with init
+static void* grow(void* items, int* count, int id, size_t size, const void* init) {
+    if (id <= *count) {
+        return items;
+    }
+    int n = *count ? *count : 64;
+    while (n < id) {
+        n *= 2;
+    }
+    char* grown = realloc(items, size * n);
+    if (!grown) {
+        perror("realloc");
+        exit(1);
+    }
+    for (int i = *count; i < n; ++i) {
+        memcpy(grown + size * i, init, size);
+    }
+    *count = n;
+    return grown;
+}
+
+static PassengerTrack* passenger(int id) {
+    static const PassengerTrack fresh = { -1, -1, -1, 0 };
+    passengers = grow(passengers, &num_passengers, id, sizeof(PassengerTrack), &fresh);
+    return &passengers[id - 1];
+}
+
+static CarTrack* car(int id) {
+    static const CarTrack fresh = { 0, -1, 0, 0 }; // cars are idle from opening
+    cars = grow(cars, &num_cars, id, sizeof(CarTrack), &fresh);
+    return &cars[id - 1];
+}
+
+static BoothStats* booth(int index) {
+    static const BoothStats fresh = { 0, 0 };
+    booths = grow(booths, &num_booths, index + 1, sizeof(BoothStats), &fresh);
+    if (index >= booths_seen) {
+        booths_seen = index + 1;
+    }
+    return &booths[index];
+}
+
+static int is_car_event(int type) {
+    return type == LOG_CAR_LOADING || type == LOG_CAR_TIMEOUT || type == LOG_CAR_RUNNING ||
+           type == LOG_CAR_UNLOADED || type == LOG_CAR_EXITING;
+}
+
+static int counted(const Filter* f, const TraceRecord* rec) {
+    if (rec->time < f->from || rec->time >= f->to) {
+        return 0;
+    }
+    if (f->passenger && (is_car_event(rec->type) || rec->entity != f->passenger)) {
+        return 0;
+    }
+    if (f->car && rec->car != f->car) {
+        return 0;
+    }
+    return 1;
+}
+
+//a pair is only counted when its end record is not before its start
+static int in_order(int64_t start, int64_t end) {
+    if (end < start) {
+        dropped++;
+        return 0;
+    }
+    return 1;
+}
+
+static void replay(const TraceRecord* rec, const Filter* f, Stats* stats) {
+    int64_t t = rec->time;
+    int count = counted(f, rec);
+    switch (rec->type) {
+        case LOG_EXPLORING: {
+            PassengerTrack* p = passenger(rec->entity);
+            p->joined = t + rec->value * NS_PER_SEC;
+            p->served = p->got = -1;
+            break;
+        }
+        case LOG_GETTING_TICKET: {
+            PassengerTrack* p = passenger(rec->entity);
+            p->served = t;
+            p->booth = rec->value - 1;
+            break;
+        }
+        case LOG_GOT_TICKET: {
+            PassengerTrack* p = passenger(rec->entity);
+            if (count && p->joined >= 0 && in_order(p->joined, t)) {
+                stats_ticket(stats, t - p->joined);
+            }
+            if (count && p->served >= 0 && in_order(p->served, t)) {
+                BoothStats* b = booth(p->booth);
+                b->tickets_sold++;
+                b->service_time += (t - p->served) / 1e6;
+            }
+            p->joined = p->served = -1;
+            p->got = t;
+            break;
+        }
+        case LOG_BOARDED: {
+            PassengerTrack* p = passenger(rec->entity);
+            if (count && p->got >= 0 && in_order(p->got, t)) {
+                stats_ride_wait(stats, t - p->got);
+            }
+            p->got = -1;
+            CarTrack* c = car(rec->car);
+            c->boarded = rec->value;
+            c->capacity = rec->capacity;
+            break;
+        }
+        case LOG_CAR_LOADING: {
+            CarTrack* c = car(rec->car);
+            if (count && c->idle_since >= 0 && in_order(c->idle_since, t)) {
+                stats_latency(stats, LAT_CAR_IDLE, t - c->idle_since);
+            }
+            c->idle_since = -1;
+            c->loading_since = t;
+            c->boarded = 0;
+            break;
+        }
+        case LOG_CAR_TIMEOUT:
+            car(rec->car)->capacity = rec->capacity;
+            break;
+        case LOG_CAR_RUNNING: {
+            CarTrack* c = car(rec->car);
+            if (count && c->loading_since >= 0 && in_order(c->loading_since, t)) {
+                stats_latency(stats, LAT_CAR_LOAD, t - c->loading_since);
+                stats_ride(stats, c->boarded, c->capacity);
+            }
+            c->loading_since = -1;
+            break;
+        }
+        case LOG_CAR_UNLOADED: {
+            CarTrack* c = car(rec->car);
+            c->idle_since = t;
+            c->loading_since = -1;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [--from seconds] [--to seconds] [--passenger n] [--car n] trace\n", name);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option long_options[] = {
+        { "from", required_argument, NULL, 'f' },
+        { "to", required_argument, NULL, 't' },
+        { "passenger", required_argument, NULL, 'p' },
+        { "car", required_argument, NULL, 'c' },
+        { NULL, 0, NULL, 0 }
+    };
+    Filter filter = { 0, INT64_MAX, 0, 0 };
+    int opt;
+    while ((opt = getopt_long(argc, argv, "f:t:p:c:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'f': filter.from = atof(optarg) * NS_PER_SEC; break;
+            case 't': filter.to = atof(optarg) * NS_PER_SEC; break;
+            case 'p': filter.passenger = atoi(optarg); break;
+            case 'c': filter.car = atoi(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1) {
+        usage(argv[0]);
+    }
+    const char* path = argv[optind];
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st)) {
+        perror(path);
+        return 1;
+    }
+    if ((size_t)st.st_size < sizeof(TraceHeader)) {
+        fprintf(stderr, "%s: not a park trace\n", path);
+        return 1;
+    }
+    const char* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+    close(fd);
+    posix_madvise((void*)map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    const TraceHeader* header = (const TraceHeader*)map;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "%s: not a park trace, or from another version\n", path);
+        return 1;
+    }
+    const TraceRecord* records = (const TraceRecord*)(map + sizeof(TraceHeader));
+    size_t count = (st.st_size - sizeof(TraceHeader)) / sizeof(TraceRecord); // a cut off last record is ignored
+
+    Stats* stats = stats_new();
+    int64_t end = 0;
+    for (size_t i = 0; i < count; ++i) {
+        replay(&records[i], &filter, stats);
+        if (records[i].time > end) {
+            end = records[i].time;
+        }
+    }
+
+    int64_t window_end = filter.to < end ? filter.to : end;
+    int64_t window_start = filter.from < window_end ? filter.from : window_end;
+    int duration = (window_end - window_start) / NS_PER_SEC;
+    printf("Trace %s: %zu records\n", path, count);
+    if (filter.from > 0 || filter.to < INT64_MAX) {
+        printf("Window: %.3f s to %.3f s\n", window_start / 1e9, window_end / 1e9);
+    }
+    if (filter.passenger) {
+        printf("Passenger %d only\n", filter.passenger);
+    }
+    if (filter.car) {
+        printf("Car %d only\n", filter.car);
+    }
+
+    ParkStats s;
+    ParkConfig cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.seed = header->seed;
+    cfg.dispatch = -1;
+    stats_read(stats, &s);
+    print_final_stats(&s, &cfg, duration);
+    print_booth_stats(booths, booths_seen, duration);
+    if (dropped > 0) {
+        printf("Dropped %ld pairs whose records came out of order\n", dropped);
+    }
+
+    stats_free(stats);
+    free(passengers);
+    free(cars);
+    free(booths);
+    munmap((void*)map, st.st_size);
+    return 0;
+}
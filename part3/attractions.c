@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "park.h"
+
+//park layout settings that are more than a number: the attraction list and pick policy, the arrival schedule
+
+//attraction list for -A, one attraction per line:
+//  name cars capacity wait ride platforms popularity
+//blank lines and lines starting with # are skipped
+
+int load_attractions(const char* path, AttractionConfig** out) {
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    AttractionConfig* list = NULL;
+    int count = 0;
+    int size = 0;
+    char line[256];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char* p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        AttractionConfig a;
+        memset(&a, 0, sizeof(a));
+        if (sscanf(p, "%31s %d %d %d %d %d %d", a.name, &a.cars, &a.capacity, &a.wait_seconds,
+                   &a.ride_seconds, &a.platforms, &a.popularity) != 7 ||
+            a.cars < 0 || a.wait_seconds < 0 || a.ride_seconds < 0) {
+            fprintf(stderr, "%s:%d: expected name cars capacity wait ride platforms popularity\n", path, line_no);
+            free(list);
+            fclose(f);
+            return -1;
+        }
+        if (count == size) {
+            size = size ? size * 2 : 8;
+            AttractionConfig* grown = realloc(list, sizeof(AttractionConfig) * size);
+            if (!grown) {
+                perror("realloc");
+                free(list);
+                fclose(f);
+                return -1;
+            }
+            list = grown;
+        }
+        list[count++] = a;
+    }
+    fclose(f);
+    if (count == 0) {
+        fprintf(stderr, "%s: no attractions\n", path);
+        free(list);
+        return -1;
+    }
+    *out = list;
+    return count;
+}
+
+int parse_policy(const char* name) {
+    if (strcmp(name, "random") == 0) return PICK_RANDOM;
+    if (strcmp(name, "shortest") == 0) return PICK_SHORTEST;
+    if (strcmp(name, "weighted") == 0) return PICK_WEIGHTED;
+    return -1;
+}
+
+//a day with a morning opening, a midday peak and an evening close, for --arrivals day
+static const char* day_schedule = "0:0,9:600,11:1500,14:1000,18:400,21:0";
+
+//hour:rate pairs, comma separated and in order of the hour, e.g. 0:0,9:600,12:1800,21:0
+int parse_arrivals(const char* spec, ArrivalPoint** out) {
+    if (strcmp(spec, "day") == 0) {
+        spec = day_schedule;
+    }
+    int size = 1;
+    for (const char* c = spec; *c; ++c) {
+        size += *c == ',';
+    }
+    ArrivalPoint* points = calloc(size, sizeof(ArrivalPoint));
+    if (!points) {
+        perror("calloc");
+        return -1;
+    }
+    int count = 0;
+    const char* p = spec;
+    while (*p) {
+        char* end;
+        double start = strtod(p, &end);
+        if (end == p || *end != ':') break;
+        p = end + 1;
+        double rate = strtod(p, &end);
+        if (end == p || rate < 0 || start < 0 || start >= 24 || (count > 0 && start <= points[count - 1].start)) break;
+        points[count].start = start;
+        points[count].rate = rate;
+        count++;
+        p = end;
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            break;
+        }
+    }
+    if (*p || count == 0) {
+        fprintf(stderr, "--arrivals takes day or hour:rate pairs in order of the hour, e.g. 0:0,9:600,21:0\n");
+        free(points);
+        return -1;
+    }
+    *out = points;
+    return count;
+}
@@ -0,0 +1,367 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "checkpoint.h"
+
+#define CHECK_SECONDS 60 // park time between looks at the signal flag and the interval
+
+static volatile sig_atomic_t requested = 0;
+static char final_path[4096];
+static char temp_path[4096];
+static int64_t interval;
+static int64_t next_due;
+static pid_t writer = 0;
+static int writer_failed = 0;
+
+//lists that outlive checkpoint_read, the restored config points at them
+static AttractionConfig* saved_attractions = NULL;
+static ArrivalPoint* saved_arrivals = NULL;
+
+//the child may only use calls that are safe after fork in a threaded process, so no stdio and no malloc
+typedef struct {
+    int fd;
+    int failed;
+    size_t len;
+    char buf[1 << 16];
+} Out;
+
+static void out_flush(Out* out) {
+    size_t done = 0;
+    while (done < out->len && !out->failed) {
+        ssize_t n = write(out->fd, out->buf + done, out->len - done);
+        if (n <= 0) {
+            out->failed = 1;
+        } else {
+            done += n;
+        }
+    }
+    out->len = 0;
+}
+
+static void put(Out* out, const void* data, size_t size) {
+    const char* p = data;
+    while (size > 0 && !out->failed) {
+        if (out->len == sizeof(out->buf)) {
+            out_flush(out);
+        }
+        size_t n = sizeof(out->buf) - out->len;
+        n = n < size ? n : size;
+        memcpy(out->buf + out->len, p, n);
+        out->len += n;
+        p += n;
+        size -= n;
+    }
+}
+
+//ids in line order, the ring itself depends on how the queue grew
+static void put_queue(Out* out, const Queue* q) {
+    for (int i = 0; i < q->count; ++i) {
+        put(out, &q->items[(q->head + i) % q->size], sizeof(int));
+    }
+}
+
+static void fill_header(Sim* sim, const Calendar* cal, CheckpointHeader* h) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, CHECKPOINT_MAGIC, sizeof(h->magic));
+    h->sizes[0] = sizeof(CheckpointHeader);
+    h->sizes[1] = sizeof(Passenger);
+    h->sizes[2] = sizeof(Car);
+    h->sizes[3] = sizeof(Event);
+    h->sizes[4] = sizeof(AttractionState);
+    h->sizes[5] = sizeof(StatsTotals);
+    h->sizes[6] = sizeof(GuestChunk);
+    h->sizes[7] = sizeof(GuestTotals);
+    h->now = sim_now;
+    h->cfg = sim->cfg;
+    h->cfg.attractions = NULL;
+    h->cfg.arrivals = NULL;
+    h->seq = cal->seq;
+    h->events = cal->len;
+    h->free_passenger = sim->free_passenger;
+    h->num_records = sim->num_records;
+    h->guests = sim->guests;
+    h->peak_guests = sim->peak_guests;
+    h->arrived = sim->arrived;
+    h->left = sim->left;
+    h->tickets_waiting = sim->ticket_queue.count;
+    h->free_booths = sim->free_booths;
+    h->arrival_rng = sim->arrival_rng;
+}
+
+//runs in the forked child, nothing else runs in it, so no locks are taken
+static int write_state(Sim* sim, const Calendar* cal, int fd) {
+    Out out;
+    out.fd = fd;
+    out.failed = 0;
+    out.len = 0;
+
+    CheckpointHeader h;
+    fill_header(sim, cal, &h);
+    put(&out, &h, sizeof(h));
+    put(&out, sim->cfg.attractions, sizeof(AttractionConfig) * sim->cfg.num_attractions);
+    put(&out, sim->cfg.arrivals, sizeof(ArrivalPoint) * sim->cfg.num_arrivals);
+    put(&out, cal->heap, sizeof(Event) * cal->len);
+    for (int p = 0; p < sim->num_records; p += PASSENGER_CHUNK) {
+        int n = sim->num_records - p < PASSENGER_CHUNK ? sim->num_records - p : PASSENGER_CHUNK;
+        put(&out, sim->chunks[p >> PASSENGER_CHUNK_BITS], sizeof(Passenger) * n);
+    }
+    for (int g = 0; g < sim->num_records; g += GUEST_CHUNK) {
+        put(&out, sim->guest_table.chunks[g >> GUEST_CHUNK_BITS], sizeof(GuestChunk));
+    }
+    put(&out, sim->guest_table.left, sizeof(GuestTotals));
+    put(&out, sim->cars, sizeof(Car) * sim->num_cars);
+    put_queue(&out, &sim->ticket_queue);
+    put(&out, sim->booths, sizeof(int) * sim->cfg.booths);
+    put(&out, sim->booth_stats, sizeof(BoothStats) * sim->cfg.booths);
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        AttractionState st = {
+            a->loading_count, atomic_load(&a->waiting), a->rides, a->riders, a->ride_wait,
+            atomic_load(&a->rate.last), atomic_load(&a->rate.gap), a->ride_queue.count, a->car_queue.count
+        };
+        put(&out, &st, sizeof(st));
+        put_queue(&out, &a->ride_queue);
+        put_queue(&out, &a->car_queue);
+        put(&out, a->platforms, sizeof(int) * a->cfg.platforms);
+        put(&out, a->loading, sizeof(int) * a->cfg.platforms);
+    }
+    StatsTotals totals;
+    stats_totals(sim->stats, &totals);
+    put(&out, &totals, sizeof(totals));
+    out_flush(&out);
+    return out.failed ? -1 : 0;
+}
+
+static void reap(int wait) {
+    int status;
+    if (writer > 0 && waitpid(writer, &status, wait ? 0 : WNOHANG) == writer) {
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            writer_failed = 1;
+        }
+        writer = 0;
+    }
+}
+
+static void take(Sim* sim) {
+    fflush(stdout); // or the child's copy of the buffer is lost with it, which is fine, but keep the order obvious
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        writer_failed = 1;
+        return;
+    }
+    if (pid == 0) {
+        int fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        int failed = fd < 0 || write_state(sim, sim->driver, fd) != 0;
+        if (fd >= 0 && (close(fd) != 0 || failed)) {
+            unlink(temp_path);
+            failed = 1;
+        }
+        if (!failed && rename(temp_path, final_path) != 0) {
+            failed = 1;
+        }
+        _exit(failed);
+    }
+    writer = pid;
+}
+
+static int checkpoint_check(Sim* sim, void* ctx) {
+    (void)ctx;
+    if (!requested && sim_now < next_due) {
+        return 0;
+    }
+    reap(0);
+    if (writer > 0) {
+        return 0; // the last one is still being written, try again at the next check
+    }
+    requested = 0;
+    take(sim);
+    while (next_due <= sim_now) {
+        next_due += interval;
+    }
+    return 0;
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    requested = 1;
+}
+
+void checkpoint_enable(Sim* sim, const char* path, int interval_seconds) {
+    snprintf(final_path, sizeof(final_path), "%s", path);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+    interval = (int64_t)(interval_seconds > 0 ? interval_seconds : 3600) * NS_PER_SEC;
+    next_due = (sim_now / interval + 1) * interval;
+    sim->check = checkpoint_check;
+    sim->check_ctx = NULL;
+    sim->check_interval = CHECK_SECONDS * NS_PER_SEC;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1, &sa, NULL);
+}
+
+void checkpoint_finish(void) {
+    reap(1);
+    if (writer_failed) {
+        fprintf(stderr, "writing checkpoint %s failed\n", final_path);
+    }
+    free(saved_attractions);
+    free(saved_arrivals);
+    saved_attractions = NULL;
+    saved_arrivals = NULL;
+}
+
+static int get(FILE* f, void* data, size_t size) {
+    return size == 0 || fread(data, size, 1, f) == 1 ? 0 : -1;
+}
+
+static int get_queue(FILE* f, Queue* q, int count) {
+    if (count > q->size) {
+        int* items = malloc(sizeof(int) * count);
+        if (!items) {
+            return -1;
+        }
+        free(q->items);
+        q->items = items;
+        q->size = count;
+    }
+    q->head = 0;
+    q->count = count;
+    return get(f, q->items, sizeof(int) * count);
+}
+
+static int read_state(FILE* f, Sim* sim, Calendar* cal, const CheckpointHeader* h) {
+    if (calendar_init(cal, h->events) || get(f, cal->heap, sizeof(Event) * h->events)) {
+        return -1;
+    }
+    cal->len = h->events;
+    cal->seq = h->seq;
+    for (int p = 0; p < h->num_records; p += PASSENGER_CHUNK) {
+        int chunk = p >> PASSENGER_CHUNK_BITS;
+        int n = h->num_records - p < PASSENGER_CHUNK ? h->num_records - p : PASSENGER_CHUNK;
+        sim->chunks[chunk] = calloc(PASSENGER_CHUNK, sizeof(Passenger));
+        if (!sim->chunks[chunk] || get(f, sim->chunks[chunk], sizeof(Passenger) * n)) {
+            return -1;
+        }
+    }
+    //the chunk's last row in use is admitted first, the chunk read over it then sets every row as saved
+    for (int g = 0; g < h->num_records; g += GUEST_CHUNK) {
+        int last = h->num_records - g < GUEST_CHUNK ? h->num_records - 1 : g + GUEST_CHUNK - 1;
+        guests_admit(&sim->guest_table, last);
+        if (get(f, sim->guest_table.chunks[g >> GUEST_CHUNK_BITS], sizeof(GuestChunk))) {
+            return -1;
+        }
+    }
+    if (get(f, sim->guest_table.left, sizeof(GuestTotals))) {
+        return -1;
+    }
+    sim->free_passenger = h->free_passenger;
+    sim->num_records = h->num_records;
+    sim->guests = h->guests;
+    sim->peak_guests = h->peak_guests;
+    sim->arrived = h->arrived;
+    sim->left = h->left;
+    sim->arrival_rng = h->arrival_rng;
+    sim->free_booths = h->free_booths;
+    if (get(f, sim->cars, sizeof(Car) * sim->num_cars) ||
+        get_queue(f, &sim->ticket_queue, h->tickets_waiting) ||
+        get(f, sim->booths, sizeof(int) * sim->cfg.booths) ||
+        get(f, sim->booth_stats, sizeof(BoothStats) * sim->cfg.booths)) {
+        return -1;
+    }
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        AttractionState st;
+        if (get(f, &st, sizeof(st)) ||
+            get_queue(f, &a->ride_queue, st.ride_queue) ||
+            get_queue(f, &a->car_queue, st.car_queue) ||
+            get(f, a->platforms, sizeof(int) * a->cfg.platforms) ||
+            get(f, a->loading, sizeof(int) * a->cfg.platforms)) {
+            return -1;
+        }
+        a->loading_count = st.loading_count;
+        atomic_store(&a->waiting, st.waiting);
+        a->rides = st.rides;
+        a->riders = st.riders;
+        a->ride_wait = st.ride_wait;
+        atomic_store(&a->rate.last, st.rate_last);
+        atomic_store(&a->rate.gap, st.rate_gap);
+    }
+    StatsTotals* totals = malloc(sizeof(StatsTotals));
+    if (!totals || get(f, totals, sizeof(StatsTotals))) {
+        free(totals);
+        return -1;
+    }
+    stats_add_totals(sim->stats, totals);
+    free(totals);
+    return 0;
+}
+
+int checkpoint_read(Sim* sim, Calendar* cal, const char* path, int sim_seconds) {
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return -1;
+    }
+    CheckpointHeader h;
+    CheckpointHeader expect;
+    memset(&expect, 0, sizeof(expect));
+    expect.sizes[0] = sizeof(CheckpointHeader);
+    expect.sizes[1] = sizeof(Passenger);
+    expect.sizes[2] = sizeof(Car);
+    expect.sizes[3] = sizeof(Event);
+    expect.sizes[4] = sizeof(AttractionState);
+    expect.sizes[5] = sizeof(StatsTotals);
+    expect.sizes[6] = sizeof(GuestChunk);
+    expect.sizes[7] = sizeof(GuestTotals);
+    if (get(f, &h, sizeof(h)) || memcmp(h.magic, CHECKPOINT_MAGIC, sizeof(h.magic)) != 0 ||
+        memcmp(h.sizes, expect.sizes, sizeof(h.sizes)) != 0) {
+        fprintf(stderr, "%s: not a park checkpoint, or from another build\n", path);
+        fclose(f);
+        return -1;
+    }
+
+    ParkConfig cfg = h.cfg;
+    saved_attractions = cfg.num_attractions > 0 ? malloc(sizeof(AttractionConfig) * cfg.num_attractions) : NULL;
+    saved_arrivals = cfg.num_arrivals > 0 ? malloc(sizeof(ArrivalPoint) * cfg.num_arrivals) : NULL;
+    if ((cfg.num_attractions > 0 && !saved_attractions) || (cfg.num_arrivals > 0 && !saved_arrivals) ||
+        get(f, saved_attractions, sizeof(AttractionConfig) * cfg.num_attractions) ||
+        get(f, saved_arrivals, sizeof(ArrivalPoint) * cfg.num_arrivals)) {
+        fprintf(stderr, "%s: truncated checkpoint\n", path);
+        fclose(f);
+        checkpoint_finish();
+        return -1;
+    }
+    cfg.attractions = saved_attractions;
+    cfg.arrivals = saved_arrivals;
+    if (sim_seconds > 0) {
+        cfg.sim_seconds = sim_seconds;
+    }
+    if (sim_init(sim, &cfg)) {
+        fclose(f);
+        checkpoint_finish();
+        return -1;
+    }
+    sim_now = h.now;
+    atomic_store(&sim->clock, sim_now);
+    if (read_state(f, sim, cal, &h)) {
+        fprintf(stderr, "%s: truncated checkpoint\n", path);
+        fclose(f);
+        sim_free(sim);
+        checkpoint_finish();
+        return -1;
+    }
+    fclose(f);
+    int t = sim_now / NS_PER_SEC;
+    fprintf(stderr, "Restored %s at park time %02d:%02d:%02d\n", path, t / 3600, (t % 3600) / 60, t % 60);
+    return 0;
+}
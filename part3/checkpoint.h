@@ -0,0 +1,57 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdint.h>
+#include "sim.h"
+#include "stats.h"
+
+//checkpoints of a virtual time park (--checkpoint file, -v only)
+//taken between two events every --checkpoint-interval seconds of park time, and soon after a SIGUSR1
+//the park forks and the child writes its copy-on-write view of memory, so the day only stops for the fork itself
+//the child writes next to the file and renames over it, a crash mid-write leaves the last good checkpoint
+//--restore file sets the park up from one and carries on with the day, the event calendar and random streams included,
+//so the rest of the day matches a run that never stopped; -d given with it moves closing time
+//the layout is the build's own structs, a file from another build is refused
+
+#define CHECKPOINT_MAGIC "PARKCKP1"
+
+typedef struct {
+    char magic[8];   // CHECKPOINT_MAGIC, no terminator
+    uint32_t sizes[8]; // of the header and the records below, to spot another build
+    int64_t now;
+    ParkConfig cfg;  // list pointers are meaningless, the lists follow the header
+    uint64_t seq;    // calendar tie breaker
+    int32_t events;
+    int32_t free_passenger;
+    int32_t num_records;
+    int32_t guests;
+    int32_t peak_guests;
+    int32_t arrived;
+    int32_t left;
+    int32_t tickets_waiting;
+    int32_t free_booths;
+    Rng arrival_rng;
+} CheckpointHeader;
+
+//then: attraction configs (cfg.num_attractions), arrival points (cfg.num_arrivals), events, passenger records,
+//guest table chunks (one row per record), totals of the guests that left, cars, the ticket line, booths, booth stats, an AttractionState with its lines and platforms per attraction, StatsTotals
+typedef struct {
+    int32_t loading_count;
+    int32_t waiting;
+    int32_t rides;
+    int32_t riders;
+    double ride_wait;
+    int64_t rate_last;
+    int64_t rate_gap;
+    int32_t ride_queue;
+    int32_t car_queue;
+} AttractionState;
+
+//sim->check, overrides any other check
+void checkpoint_enable(Sim* sim, const char* path, int interval_seconds);
+//waits for the last writer, reports a failed one
+void checkpoint_finish(void);
+//sim_init with the saved settings, then the saved state on top; sim_seconds 0 keeps the saved closing time
+int checkpoint_read(Sim* sim, Calendar* cal, const char* path, int sim_seconds);
+
+#endif
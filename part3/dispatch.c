@@ -0,0 +1,73 @@
+#include <string.h>
+#include "dispatch.h"
+
+#define RATE_WEIGHT 8 // the newest gap counts 1/8 in the average
+
+static const char* dispatch_names[] = {
+    [DISPATCH_TIMEOUT] = "timeout",
+    [DISPATCH_QUEUE] = "queue",
+    [DISPATCH_SLA] = "sla",
+    [DISPATCH_ADAPTIVE] = "adaptive",
+};
+
+int parse_dispatch(const char* name) {
+    for (int i = 0; i < NUM_DISPATCH; ++i) {
+        if (strcmp(name, dispatch_names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const char* dispatch_name(int policy) {
+    return policy >= 0 && policy < NUM_DISPATCH ? dispatch_names[policy] : "?";
+}
+
+void dispatch_init(DispatchConfig* d, const ParkConfig* cfg, int capacity, int wait_seconds) {
+    d->policy = cfg->dispatch;
+    d->capacity = capacity;
+    d->threshold = cfg->threshold > 0 ? cfg->threshold : (capacity + 1) / 2;
+    if (d->threshold > capacity) {
+        d->threshold = capacity;
+    }
+    d->max_wait = wait_seconds * NS_PER_SEC;
+    d->target = cfg->target_seconds * NS_PER_SEC;
+}
+
+void rate_observe(ArrivalRate* r, int64_t now) {
+    int64_t last = atomic_exchange_explicit(&r->last, now, memory_order_relaxed);
+    if (last == 0) {
+        return;
+    }
+    int64_t gap = atomic_load_explicit(&r->gap, memory_order_relaxed);
+    gap = gap ? gap + (now - last - gap) / RATE_WEIGHT : now - last;
+    atomic_store_explicit(&r->gap, gap, memory_order_relaxed);
+}
+
+int64_t dispatch_deadline(const DispatchConfig* d, int boarded, int64_t since, int64_t first_ticket,
+                          const ArrivalRate* rate, int64_t now) {
+    int64_t latest = since + d->max_wait;
+    if (boarded >= d->capacity) {
+        return now;
+    }
+    if (boarded == 0) {
+        return latest; // nobody to take yet
+    }
+    switch (d->policy) {
+        case DISPATCH_QUEUE:
+            return boarded >= d->threshold ? now : latest;
+        case DISPATCH_SLA:
+            return first_ticket + d->target < latest ? first_ticket + d->target : latest;
+        case DISPATCH_ADAPTIVE: {
+            int64_t gap = atomic_load_explicit(&rate->gap, memory_order_relaxed);
+            if (gap == 0) {
+                return latest;
+            }
+            //the rest of the seats are expected to fill one gap apart from the last rider that came
+            int64_t full = atomic_load_explicit(&rate->last, memory_order_relaxed) + (d->capacity - boarded) * gap;
+            return full <= latest ? full : now;
+        }
+        default:
+            return latest;
+    }
+}
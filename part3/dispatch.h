@@ -0,0 +1,38 @@
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "park.h"
+
+//when a loading car that is not full leaves (-D), shared by the threaded and the event driven versions
+//every policy leaves at once when the car is full and never waits longer than the attraction's wait
+//timeout: waits out the whole wait for more riders, the original behaviour
+//queue: leaves as soon as --threshold riders are aboard
+//sla: leaves when the first rider aboard has waited --target seconds since getting their ticket
+//adaptive: waits as long as the observed arrival rate says the car takes to fill, leaves right away if it will not fill in time
+
+typedef struct {
+    int policy;
+    int capacity;
+    int threshold;    // riders, queue policy
+    int64_t max_wait; // ns
+    int64_t target;   // ns, sla policy
+} DispatchConfig;
+
+//riders joining one line, for the adaptive policy
+//atomic so a car can read it while passengers update it under another lock
+typedef struct {
+    atomic_llong last; // ns, when the last rider joined
+    atomic_llong gap;  // ns, moving average of the gaps, 0 until two riders joined
+} ArrivalRate;
+
+void dispatch_init(DispatchConfig* d, const ParkConfig* cfg, int capacity, int wait_seconds);
+void rate_observe(ArrivalRate* r, int64_t now);
+
+//when the car leaves if nobody else boards, now or earlier means right away
+//since is when loading started, first_ticket when the longest waiting rider aboard got their ticket
+int64_t dispatch_deadline(const DispatchConfig* d, int boarded, int64_t since, int64_t first_ticket,
+                          const ArrivalRate* rate, int64_t now);
+
+#endif
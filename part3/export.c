@@ -0,0 +1,119 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "export.h"
+
+static ExportSegment* segment = NULL;
+static char segment_name[256];
+static ExportData scratch; // filled outside the seqlock, then copied in
+
+static Stats* source_stats;
+static ParkConfig source_cfg;
+static int64_t (*source_clock)(void* ctx);
+static void* source_ctx;
+static int interval_ms;
+
+static pthread_t export_tid;
+static pthread_mutex_t export_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t export_wake = PTHREAD_COND_INITIALIZER;
+static int export_running = 0;
+
+static void publish(int running) {
+    ExportData* d = &scratch;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    d->park_time = source_clock ? source_clock(source_ctx) : park_clock();
+    d->published = now.tv_sec * NS_PER_SEC + now.tv_nsec;
+    d->updates++;
+    d->running = running;
+    d->passengers = source_cfg.passengers;
+    d->cars = source_cfg.cars;
+    d->booths = source_cfg.booths;
+    d->seed = source_cfg.seed;
+    stats_read_hist(source_stats, &d->stats, d->latency);
+
+    //only this thread writes, so a plain increment is enough, the fences order it against the copy
+    unsigned seq = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+    atomic_store_explicit(&segment->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&segment->data, d, sizeof(*d));
+    atomic_store_explicit(&segment->seq, seq + 2, memory_order_release);
+}
+
+static void* export_thread(void* arg) {
+    (void)arg;
+    pthread_mutex_lock(&export_mutex);
+    while (export_running) {
+        pthread_mutex_unlock(&export_mutex);
+        publish(1);
+        pthread_mutex_lock(&export_mutex);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        int64_t ns = deadline.tv_nsec + (int64_t)interval_ms * 1000000;
+        deadline.tv_sec += ns / NS_PER_SEC;
+        deadline.tv_nsec = ns % NS_PER_SEC;
+        while (export_running && pthread_cond_timedwait(&export_wake, &export_mutex, &deadline) == 0) {
+        }
+    }
+    pthread_mutex_unlock(&export_mutex);
+    return NULL;
+}
+
+int export_start(const char* name, int interval, Stats* stats, const ParkConfig* cfg,
+                 int64_t (*clock)(void* ctx), void* ctx) {
+    snprintf(segment_name, sizeof(segment_name), "%s%s", name[0] == '/' ? "" : "/", name);
+    int fd = shm_open(segment_name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror(segment_name);
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(ExportSegment))) {
+        perror("ftruncate");
+        close(fd);
+        return -1;
+    }
+    segment = mmap(NULL, sizeof(ExportSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        perror("mmap");
+        segment = NULL;
+        return -1;
+    }
+    //a segment left over from an earlier park is reused, seq keeps counting so its readers resync
+    segment->size = sizeof(ExportSegment);
+    segment->pid = getpid();
+    memcpy(segment->magic, EXPORT_MAGIC, sizeof(segment->magic));
+
+    memset(&scratch, 0, sizeof(scratch));
+    source_stats = stats;
+    source_cfg = *cfg;
+    source_clock = clock;
+    source_ctx = ctx;
+    interval_ms = interval > 0 ? interval : 1;
+    export_running = 1;
+    pthread_create(&export_tid, NULL, export_thread, NULL);
+    return 0;
+}
+
+void export_stop(void) {
+    if (!segment) {
+        return;
+    }
+    pthread_mutex_lock(&export_mutex);
+    export_running = 0;
+    pthread_cond_signal(&export_wake);
+    pthread_mutex_unlock(&export_mutex);
+    pthread_join(export_tid, NULL);
+
+    publish(0);
+    munmap(segment, sizeof(ExportSegment));
+    shm_unlink(segment_name);
+    segment = NULL;
+}
@@ -0,0 +1,45 @@
+#ifndef EXPORT_H
+#define EXPORT_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "park.h"
+#include "stats.h"
+#include "hist.h"
+
+//live statistics in POSIX shared memory (--export name), read by park-top or any other process
+//a background thread republishes every --export-interval ms under a seqlock:
+//seq is odd while the data is being written, a reader copies the data and retries if seq was odd or changed
+//the park never waits for a reader, a reader never takes a lock
+
+#define EXPORT_MAGIC "PARKSHM1"
+#define EXPORT_DEFAULT_NAME "/park"
+
+typedef struct {
+    int64_t park_time; // ns since the park opened, simulated for -v
+    int64_t published; // CLOCK_REALTIME ns, lets a reader spot a dead park
+    uint64_t updates;
+    int running;       // 0 after the last update of the day
+    int passengers;
+    int cars;
+    int booths;
+    uint64_t seed;
+    ParkStats stats;
+    HistSnapshot latency[NUM_LATENCIES];
+} ExportData;
+
+typedef struct {
+    char magic[8];     // EXPORT_MAGIC, no terminator
+    uint32_t size;     // sizeof(ExportSegment)
+    int32_t pid;
+    atomic_uint seq;
+    ExportData data;
+} ExportSegment;
+
+//park_clock is read on the export thread if clock is NULL
+int export_start(const char* name, int interval_ms, Stats* stats, const ParkConfig* cfg,
+                 int64_t (*clock)(void* ctx), void* ctx);
+//publishes a last update with running = 0 and removes the name, readers that have it mapped keep the data
+void export_stop(void);
+
+#endif
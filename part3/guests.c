@@ -0,0 +1,215 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "guests.h"
+#include "hist.h"
+
+void guests_init(GuestTable* t) {
+    memset(t->chunks, 0, sizeof(t->chunks));
+    atomic_init(&t->count, 0);
+    pthread_mutex_init(&t->lock, NULL);
+    t->left = calloc(1, sizeof(GuestTotals));
+    if (!t->left) {
+        perror("calloc");
+        exit(1);
+    }
+    hist_clear(&t->left->waits);
+}
+
+void guests_free(GuestTable* t) {
+    for (int i = 0; i < MAX_GUEST_CHUNKS && t->chunks[i]; ++i) {
+        free(t->chunks[i]);
+        t->chunks[i] = NULL;
+    }
+    atomic_store(&t->count, 0);
+    pthread_mutex_destroy(&t->lock);
+    free(t->left);
+    t->left = NULL;
+}
+
+void guests_admit(GuestTable* t, int g) {
+    int chunk = g >> GUEST_CHUNK_BITS;
+    if (chunk >= MAX_GUEST_CHUNKS) {
+        fprintf(stderr, "more than %d guests in the park at once\n", MAX_GUEST_CHUNKS * GUEST_CHUNK);
+        exit(1);
+    }
+    if (!t->chunks[chunk]) {
+        t->chunks[chunk] = calloc(1, sizeof(GuestChunk));
+        if (!t->chunks[chunk]) {
+            perror("calloc");
+            exit(1);
+        }
+    }
+    //a freed row was zeroed when it was freed
+    __atomic_store_n(&t->chunks[chunk]->phase[g & (GUEST_CHUNK - 1)], (uint8_t)GUEST_EXPLORING, __ATOMIC_RELAXED);
+    if (g >= atomic_load_explicit(&t->count, memory_order_relaxed)) {
+        atomic_store_explicit(&t->count, g + 1, memory_order_release);
+    }
+}
+
+void guests_left(GuestTable* t, int g) {
+    GuestChunk* c = t->chunks[g >> GUEST_CHUNK_BITS];
+    int i = g & (GUEST_CHUNK - 1);
+    int rides = c->rides[i];
+    int64_t wait = c->wait[i];
+    pthread_mutex_lock(&t->lock);
+    GuestTotals* left = t->left;
+    left->guests++;
+    left->phases[GUEST_LEFT]++;
+    left->ride_sum += rides;
+    left->ride_sq += (double)rides * rides;
+    if (rides > left->rides_max) {
+        left->rides_max = rides;
+    }
+    left->ride_counts[rides < MAX_RIDES_COUNTED ? rides : MAX_RIDES_COUNTED]++;
+    left->wait_sum += wait / 1e9;
+    left->wait_sq += (wait / 1e9) * (wait / 1e9);
+    hist_count(&left->waits, wait / 1000000);
+    pthread_mutex_unlock(&t->lock);
+    guest_moved_out(t, g); // zeroes the row the same way
+}
+
+//Jain's fairness index, (sum x)^2 / (n * sum x^2)
+static double fairness(double sum, double sum_sq, int n) {
+    return sum_sq > 0 ? sum * sum / (n * sum_sq) : 1;
+}
+
+//the per chunk loops are plain reductions over one array each, with no calls or branches the compiler cannot turn into selects
+void guests_totals(GuestTable* t, int64_t now, GuestTotals* out) {
+    memset(out, 0, sizeof(*out));
+    hist_clear(&out->waits);
+    pthread_mutex_lock(&t->lock);
+    guests_add_totals(out, t->left);
+    pthread_mutex_unlock(&t->lock);
+    int count = atomic_load_explicit(&t->count, memory_order_acquire);
+    int64_t* wait_ns = malloc(sizeof(int64_t) * GUEST_CHUNK); // one chunk's waits up to now
+    if (!wait_ns) {
+        perror("malloc");
+        exit(1);
+    }
+
+    for (int base = 0; base < count; base += GUEST_CHUNK) {
+        const GuestChunk* c = t->chunks[base >> GUEST_CHUNK_BITS];
+        int n = count - base < GUEST_CHUNK ? count - base : GUEST_CHUNK;
+
+        int phases[NUM_GUEST_PHASES] = { 0 };
+        for (int i = 0; i < n; ++i) {
+            uint8_t ph = c->phase[i];
+            phases[GUEST_EXPLORING] += ph == GUEST_EXPLORING;
+            phases[GUEST_TICKET] += ph == GUEST_TICKET;
+            phases[GUEST_QUEUED] += ph == GUEST_QUEUED;
+            phases[GUEST_RIDING] += ph == GUEST_RIDING;
+            phases[GUEST_FREE] += ph == GUEST_FREE;
+        }
+        for (int p = 0; p < NUM_GUEST_PHASES; ++p) {
+            out->phases[p] += phases[p];
+        }
+
+        //free rows are zeroed, they only need leaving out of the counts
+        int64_t rsum = 0, rsq = 0;
+        int rmax = 0;
+        for (int i = 0; i < n; ++i) {
+            int32_t r = c->rides[i];
+            rsum += r;
+            rsq += (int64_t)r * r;
+            rmax = r > rmax ? r : rmax;
+        }
+        out->ride_sum += rsum;
+        out->ride_sq += rsq;
+        if (rmax > out->rides_max) {
+            out->rides_max = rmax;
+        }
+        for (int i = 0; i < n; ++i) {
+            int32_t r = c->rides[i];
+            out->ride_counts[r < MAX_RIDES_COUNTED ? r : MAX_RIDES_COUNTED] += c->phase[i] != GUEST_FREE;
+        }
+
+        int64_t* w = wait_ns;
+        for (int i = 0; i < n; ++i) {
+            int in_line = c->phase[i] == GUEST_TICKET || c->phase[i] == GUEST_QUEUED;
+            int64_t since = now - c->joined[i];
+            w[i] = c->wait[i] + (in_line && since > 0 ? since : 0);
+        }
+        double wsum = 0, wsq = 0;
+        for (int i = 0; i < n; ++i) {
+            double s = w[i] / 1e9;
+            wsum += s;
+            wsq += s * s;
+        }
+        out->wait_sum += wsum;
+        out->wait_sq += wsq;
+        for (int i = 0; i < n; ++i) {
+            if (c->phase[i] != GUEST_FREE) {
+                hist_count(&out->waits, w[i] / 1000000);
+            }
+        }
+    }
+    out->guests += count - out->phases[GUEST_FREE];
+    free(wait_ns);
+}
+
+void guests_add_totals(GuestTotals* into, const GuestTotals* from) {
+    into->guests += from->guests;
+    for (int p = 0; p < NUM_GUEST_PHASES; ++p) {
+        into->phases[p] += from->phases[p];
+    }
+    into->ride_sum += from->ride_sum;
+    into->ride_sq += from->ride_sq;
+    if (from->rides_max > into->rides_max) {
+        into->rides_max = from->rides_max;
+    }
+    into->wait_sum += from->wait_sum;
+    into->wait_sq += from->wait_sq;
+    for (int r = 0; r <= MAX_RIDES_COUNTED; ++r) {
+        into->ride_counts[r] += from->ride_counts[r];
+    }
+    for (int b = 0; b < HIST_BUCKETS; ++b) {
+        into->waits.counts[b] += from->waits.counts[b];
+    }
+    into->waits.total += from->waits.total;
+    if (from->waits.max > into->waits.max) {
+        into->waits.max = from->waits.max;
+    }
+}
+
+void guests_summary(const GuestTotals* totals, GuestSummary* out) {
+    memset(out, 0, sizeof(*out));
+    int count = totals->guests;
+    out->guests = count;
+    memcpy(out->phases, totals->phases, sizeof(out->phases));
+    out->rides_max = totals->rides_max;
+    if (count == 0) {
+        return;
+    }
+    out->rides_avg = (double)totals->ride_sum / count;
+    out->rides_fairness = fairness(totals->ride_sum, totals->ride_sq, count);
+    int seen = 0;
+    out->rides_p50 = -1;
+    out->rides_p90 = -1;
+    for (int r = 0; r <= MAX_RIDES_COUNTED; ++r) {
+        seen += totals->ride_counts[r];
+        if (out->rides_p50 < 0 && seen * 2LL >= count) {
+            out->rides_p50 = r;
+        }
+        if (out->rides_p90 < 0 && seen * 10LL >= count * 9LL) {
+            out->rides_p90 = r;
+            break;
+        }
+    }
+    out->wait_avg = totals->wait_sum / count;
+    out->wait_p50 = hist_percentile(&totals->waits, 50) / 1e3;
+    out->wait_p90 = hist_percentile(&totals->waits, 90) / 1e3;
+    out->wait_max = totals->waits.max / 1e3;
+    out->wait_fairness = fairness(totals->wait_sum, totals->wait_sq, count);
+}
+
+void guests_scan(GuestTable* t, int64_t now, GuestSummary* out) {
+    GuestTotals* totals = malloc(sizeof(GuestTotals));
+    if (!totals) {
+        perror("malloc");
+        exit(1);
+    }
+    guests_totals(t, now, totals);
+    guests_summary(totals, out);
+    free(totals);
+}
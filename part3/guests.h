@@ -0,0 +1,109 @@
+#ifndef GUESTS_H
+#define GUESTS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "park.h"
+#include "hist.h"
+
+//per guest table for the monitor, one row per passenger record and laid out as a struct of arrays
+//each field of a chunk is one array, so a scan walks a few dense arrays instead of whole passenger records
+//a guest that leaves is folded into running totals and its row is free for the guest that gets the record next,
+//so the table grows with the guests in the park at once, like the passenger records
+//a guest's entries are written only by whoever runs that guest at the time, with relaxed stores
+//the monitor scans the rows without a lock, a guest it catches mid update or leaving counts as before or after it
+//chunks never move, so the table grows while it is scanned
+
+#define GUEST_CHUNK_BITS 14
+#define GUEST_CHUNK (1 << GUEST_CHUNK_BITS)
+#define MAX_GUEST_CHUNKS 1024 // 16M guests in the park at once
+#define MAX_RIDES_COUNTED 1024 // rides per guest above this share the last count, for the percentiles only
+
+typedef struct {
+    uint8_t phase[GUEST_CHUNK];  // GuestPhase
+    int32_t rides[GUEST_CHUNK];
+    int64_t wait[GUEST_CHUNK];   // ns in the ticket and ride lines, lines left so far
+    int64_t joined[GUEST_CHUNK]; // when the guest joined the line it is in, on the driver's clock
+} GuestChunk;
+
+//sums a scan leaves, tables of several parks add up before the summary (shard.c)
+typedef struct {
+    int guests;
+    int phases[NUM_GUEST_PHASES];
+    int64_t ride_sum;
+    double ride_sq;
+    int rides_max;
+    double wait_sum; // s
+    double wait_sq;
+    int ride_counts[MAX_RIDES_COUNTED + 1];
+    HistSnapshot waits; // ms, a histogram of ns would top out at under 5 hours in lines
+} GuestTotals;
+
+typedef struct {
+    GuestChunk* chunks[MAX_GUEST_CHUNKS];
+    atomic_int count;     // rows handed out, published after their chunk
+    pthread_mutex_t lock; // guards left
+    GuestTotals* left;    // guests that left the park
+} GuestTable;
+
+void guests_init(GuestTable* t);
+void guests_free(GuestTable* t);
+//row g starts a new guest, a fresh row or one freed by guests_left or guest_moved_out, one caller at a time
+void guests_admit(GuestTable* t, int g);
+//the guest in row g left the park, its figures go to the running totals and the row is free
+void guests_left(GuestTable* t, int g);
+//the whole table in one pass per field plus the guests that left, takes milliseconds for a million guests
+//now is on the clock the joined times were taken on, guests still in a line count what they waited up to now
+void guests_scan(GuestTable* t, int64_t now, GuestSummary* out);
+void guests_totals(GuestTable* t, int64_t now, GuestTotals* out);
+void guests_add_totals(GuestTotals* into, const GuestTotals* from);
+void guests_summary(const GuestTotals* totals, GuestSummary* out);
+
+static inline void guest_phase(GuestTable* t, int g, int phase) {
+    GuestChunk* c = t->chunks[g >> GUEST_CHUNK_BITS];
+    __atomic_store_n(&c->phase[g & (GUEST_CHUNK - 1)], (uint8_t)phase, __ATOMIC_RELAXED);
+}
+
+//GUEST_TICKET or GUEST_QUEUED
+static inline void guest_joined(GuestTable* t, int g, int phase, int64_t now) {
+    GuestChunk* c = t->chunks[g >> GUEST_CHUNK_BITS];
+    int i = g & (GUEST_CHUNK - 1);
+    __atomic_store_n(&c->joined[i], now, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->phase[i], (uint8_t)phase, __ATOMIC_RELAXED);
+}
+
+//left a line after ns
+static inline void guest_waited(GuestTable* t, int g, int64_t ns) {
+    GuestChunk* c = t->chunks[g >> GUEST_CHUNK_BITS];
+    int i = g & (GUEST_CHUNK - 1);
+    __atomic_store_n(&c->wait[i], c->wait[i] + ns, __ATOMIC_RELAXED);
+}
+
+//walked in from another shard with its figures so far, it walks until it reaches the ticket line
+static inline void guest_moved_in(GuestTable* t, int g, int rides, int64_t wait) {
+    GuestChunk* c = t->chunks[g >> GUEST_CHUNK_BITS];
+    int i = g & (GUEST_CHUNK - 1);
+    __atomic_store_n(&c->rides[i], rides, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->wait[i], wait, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->phase[i], (uint8_t)GUEST_EXPLORING, __ATOMIC_RELAXED);
+}
+
+//walked to another shard, its figures went along and the row is free
+static inline void guest_moved_out(GuestTable* t, int g) {
+    GuestChunk* c = t->chunks[g >> GUEST_CHUNK_BITS];
+    int i = g & (GUEST_CHUNK - 1);
+    __atomic_store_n(&c->phase[i], (uint8_t)GUEST_FREE, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->rides[i], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->wait[i], 0, __ATOMIC_RELAXED);
+}
+
+//boarded a car
+static inline void guest_rode(GuestTable* t, int g) {
+    GuestChunk* c = t->chunks[g >> GUEST_CHUNK_BITS];
+    int i = g & (GUEST_CHUNK - 1);
+    __atomic_store_n(&c->rides[i], c->rides[i] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&c->phase[i], (uint8_t)GUEST_RIDING, __ATOMIC_RELAXED);
+}
+
+#endif
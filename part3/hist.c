@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <math.h>
+#include "hist.h"
+
+static int bucket(int64_t ns) {
+    uint64_t v = ns > 0 ? (uint64_t)ns : 0;
+    if (v < (1u << HIST_SUB_BITS)) {
+        return v;
+    }
+    int exp = 63 - __builtin_clzll(v);
+    if (exp >= HIST_MAX_BITS) {
+        return HIST_BUCKETS - 1;
+    }
+    int sub = (v >> (exp - HIST_SUB_BITS)) & ((1u << HIST_SUB_BITS) - 1);
+    return ((exp - HIST_SUB_BITS + 1) << HIST_SUB_BITS) + sub;
+}
+
+//highest value that maps to the bucket
+static int64_t bucket_top(int b) {
+    if (b < (1 << HIST_SUB_BITS)) {
+        return b;
+    }
+    int exp = (b >> HIST_SUB_BITS) + HIST_SUB_BITS - 1;
+    int sub = b & ((1 << HIST_SUB_BITS) - 1);
+    int shift = exp - HIST_SUB_BITS;
+    return ((int64_t)((1 << HIST_SUB_BITS) + sub + 1) << shift) - 1;
+}
+
+void hist_init(Histogram* h) {
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        atomic_init(&h->counts[i], 0);
+    }
+    atomic_init(&h->max, 0);
+}
+
+void hist_record(Histogram* h, int64_t ns) {
+    atomic_fetch_add_explicit(&h->counts[bucket(ns)], 1, memory_order_relaxed);
+    long long max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (ns > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, ns,
+                                                              memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void hist_clear(HistSnapshot* snap) {
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        snap->counts[i] = 0;
+    }
+    snap->total = 0;
+    snap->max = 0;
+}
+
+void hist_count(HistSnapshot* snap, int64_t ns) {
+    snap->counts[bucket(ns)]++;
+    snap->total++;
+    if (ns > snap->max) {
+        snap->max = ns;
+    }
+}
+
+void hist_add(Histogram* h, const HistSnapshot* snap) {
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        atomic_fetch_add_explicit(&h->counts[i], snap->counts[i], memory_order_relaxed);
+    }
+    long long max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (snap->max > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, snap->max,
+                                                                     memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void hist_merge(HistSnapshot* snap, Histogram* h) {
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        uint64_t n = atomic_load_explicit(&h->counts[i], memory_order_relaxed);
+        snap->counts[i] += n;
+        snap->total += n;
+    }
+    long long max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    if (max > snap->max) {
+        snap->max = max;
+    }
+}
+
+//percentile in [0, 100], never reports more than the recorded max
+int64_t hist_percentile(const HistSnapshot* snap, double percentile) {
+    if (snap->total == 0) {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * snap->total + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        seen += snap->counts[i];
+        if (seen >= rank) {
+            if (i == HIST_BUCKETS - 1 && snap->max >= HIST_RANGE_NS) {
+                return HIST_PAST_RANGE;
+            }
+            int64_t top = bucket_top(i);
+            return top < snap->max ? top : snap->max;
+        }
+    }
+    return snap->max;
+}
+
+double hist_ms(int64_t ns) {
+    return ns == HIST_PAST_RANGE ? INFINITY : ns / 1e6;
+}
+
+void hist_print_ms(int width, double ms) {
+    if (isinf(ms)) {
+        char past[16];
+        snprintf(past, sizeof(past), ">%.1fd", HIST_RANGE_NS / 86400e9);
+        printf("%*s", width, past);
+    } else {
+        printf("%*.1f", width, ms);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+//log-linear latency histogram (HDR style), fixed memory and about 3% precision
+//values below 2^HIST_SUB_BITS ns get a bucket each, above that every power of two is split in 2^HIST_SUB_BITS buckets
+//values past HIST_MAX_BITS (about 13 days, more than a simulated week) land in the last bucket, max stays exact
+
+#define HIST_SUB_BITS 5
+#define HIST_MAX_BITS 50
+#define HIST_BUCKETS ((HIST_MAX_BITS - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+#define HIST_RANGE_NS ((int64_t)1 << HIST_MAX_BITS)
+#define HIST_PAST_RANGE INT64_MAX // percentile in the last bucket with values past the range, only known to be above it
+
+//written by one shard owner at a time with relaxed atomics, read by anyone
+typedef struct {
+    atomic_ullong counts[HIST_BUCKETS];
+    atomic_llong max;
+} Histogram;
+
+//plain copy for reading, several histograms can be merged into one
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    int64_t max;
+} HistSnapshot;
+
+void hist_init(Histogram* h);
+void hist_record(Histogram* h, int64_t ns);
+void hist_clear(HistSnapshot* snap);
+void hist_count(HistSnapshot* snap, int64_t ns); // records into a snapshot, for one thread building its own
+void hist_merge(HistSnapshot* snap, Histogram* h);
+int64_t hist_percentile(const HistSnapshot* snap, double percentile);
+double hist_ms(int64_t ns); // INFINITY for HIST_PAST_RANGE
+void hist_print_ms(int width, double ms); // %.1f, or >13.0d for a percentile past the range
+void hist_add(Histogram* h, const HistSnapshot* snap); // the reverse of merge, for restoring a checkpoint
+
+#endif
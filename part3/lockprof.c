@@ -0,0 +1,203 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "lockprof.h"
+#include "hist.h"
+
+//only built into park_lockprof, see lockprof.h
+
+#define MAX_GROUPS 16
+#define LOCK_SLOTS 8192 // open addressing, mutex address to group
+#define MAX_HELD 8      // locks one thread holds at once
+#define TOP_SITES 3
+
+typedef struct {
+    const char* name;
+    atomic_llong acquisitions;
+    atomic_llong contended;
+    atomic_llong cond_waits;
+    Histogram wait; // contended acquisitions only
+    Histogram hold;
+} LockGroup;
+
+typedef struct {
+    pthread_mutex_t* mutex;
+    int group;
+} LockSlot;
+
+typedef struct {
+    pthread_mutex_t* mutex;
+    int64_t since;
+} Held;
+
+static LockGroup groups[MAX_GROUPS];
+static int num_groups = 0;
+static LockSlot slots[LOCK_SLOTS]; // filled before the threads start, only read after
+static _Atomic(LockSite*) sites = NULL;
+
+static __thread Held held[MAX_HELD];
+static __thread int num_held = 0;
+
+static int64_t now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static unsigned slot_of(const pthread_mutex_t* mutex) {
+    uintptr_t x = (uintptr_t)mutex;
+    return (unsigned)((x >> 4) * 0x9e3779b97f4a7c15ULL >> 40) % LOCK_SLOTS;
+}
+
+//-1 for a mutex that was never named, it is passed straight through
+static int group_of(const pthread_mutex_t* mutex) {
+    for (unsigned i = slot_of(mutex), n = 0; n < LOCK_SLOTS; i = (i + 1) % LOCK_SLOTS, ++n) {
+        if (slots[i].mutex == mutex) return slots[i].group;
+        if (!slots[i].mutex) return -1;
+    }
+    return -1;
+}
+
+//locks with the same name share a row, e.g. every car's mutex
+void lockprof_name(pthread_mutex_t* mutex, const char* name) {
+    int g = 0;
+    while (g < num_groups && strcmp(groups[g].name, name) != 0) {
+        g++;
+    }
+    if (g == num_groups) {
+        if (num_groups == MAX_GROUPS) {
+            return;
+        }
+        LockGroup* group = &groups[num_groups++];
+        group->name = name;
+        hist_init(&group->wait);
+        hist_init(&group->hold);
+    }
+    for (unsigned i = slot_of(mutex), n = 0; n < LOCK_SLOTS; i = (i + 1) % LOCK_SLOTS, ++n) {
+        if (!slots[i].mutex || slots[i].mutex == mutex) {
+            slots[i].mutex = mutex;
+            slots[i].group = g;
+            return;
+        }
+    }
+}
+
+static void register_site(LockSite* site, int group) {
+    if (atomic_exchange(&site->registered, 1)) {
+        return;
+    }
+    site->group = group;
+    site->next = atomic_load(&sites);
+    while (!atomic_compare_exchange_weak(&sites, &site->next, site)) {
+    }
+}
+
+static void start_hold(pthread_mutex_t* mutex, int64_t now) {
+    if (num_held < MAX_HELD) {
+        held[num_held].mutex = mutex;
+        held[num_held].since = now;
+        num_held++;
+    }
+}
+
+static void end_hold(pthread_mutex_t* mutex, int group) {
+    for (int i = num_held - 1; i >= 0; --i) {
+        if (held[i].mutex == mutex) {
+            hist_record(&groups[group].hold, now_ns() - held[i].since);
+            held[i] = held[--num_held];
+            return;
+        }
+    }
+}
+
+void lockprof_lock(pthread_mutex_t* mutex, LockSite* site) {
+    int g = group_of(mutex);
+    if (g < 0) {
+        pthread_mutex_lock(mutex);
+        return;
+    }
+    register_site(site, g);
+    LockGroup* group = &groups[g];
+    int64_t wait = 0;
+    if (pthread_mutex_trylock(mutex) != 0) {
+        int64_t start = now_ns();
+        pthread_mutex_lock(mutex);
+        wait = now_ns() - start;
+        atomic_fetch_add_explicit(&group->contended, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&site->contended, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&site->wait_ns, wait, memory_order_relaxed);
+        hist_record(&group->wait, wait);
+    }
+    atomic_fetch_add_explicit(&group->acquisitions, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&site->acquisitions, 1, memory_order_relaxed);
+    start_hold(mutex, now_ns());
+}
+
+void lockprof_unlock(pthread_mutex_t* mutex) {
+    int g = group_of(mutex);
+    if (g >= 0) {
+        end_hold(mutex, g);
+    }
+    pthread_mutex_unlock(mutex);
+}
+
+//the mutex is not held while waiting, so the hold ends before the wait and starts again after it
+int lockprof_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* deadline, LockSite* site) {
+    int g = group_of(mutex);
+    if (g < 0) {
+        return deadline ? pthread_cond_timedwait(cond, mutex, deadline) : pthread_cond_wait(cond, mutex);
+    }
+    register_site(site, g);
+    end_hold(mutex, g);
+    atomic_fetch_add_explicit(&groups[g].cond_waits, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&site->acquisitions, 1, memory_order_relaxed);
+    int res = deadline ? pthread_cond_timedwait(cond, mutex, deadline) : pthread_cond_wait(cond, mutex);
+    start_hold(mutex, now_ns());
+    return res;
+}
+
+static void print_hist(const char* name, Histogram* h) {
+    HistSnapshot snap;
+    hist_clear(&snap);
+    hist_merge(&snap, h);
+    fprintf(stderr, "  %s p50/p99/max: %.1f/%.1f/%.1f us (%llu)\n", name,
+            hist_percentile(&snap, 50) / 1e3, hist_percentile(&snap, 99) / 1e3, snap.max / 1e3,
+            (unsigned long long)snap.total);
+}
+
+void lockprof_report(void) {
+    fprintf(stderr, "\nLock profile:\n");
+    for (int g = 0; g < num_groups; ++g) {
+        LockGroup* group = &groups[g];
+        long long acquisitions = atomic_load(&group->acquisitions);
+        long long contended = atomic_load(&group->contended);
+        fprintf(stderr, "%s: %lld acquisitions, %lld contended (%.1f%%), %lld condition waits\n", group->name,
+                acquisitions, contended, acquisitions ? 100.0 * contended / acquisitions : 0,
+                (long long)atomic_load(&group->cond_waits));
+        print_hist("wait", &group->wait);
+        print_hist("hold", &group->hold);
+
+        //top call sites by total wait, the site list is short so a few passes are fine
+        LockSite* shown[TOP_SITES];
+        int num_shown = 0;
+        while (num_shown < TOP_SITES) {
+            LockSite* best = NULL;
+            for (LockSite* s = atomic_load(&sites); s; s = s->next) {
+                int taken = s->group != g;
+                for (int i = 0; i < num_shown && !taken; ++i) {
+                    taken = shown[i] == s;
+                }
+                if (!taken && (!best || atomic_load(&s->wait_ns) > atomic_load(&best->wait_ns))) {
+                    best = s;
+                }
+            }
+            if (!best) break;
+            shown[num_shown++] = best;
+            fprintf(stderr, "  %s:%d %lld calls, %lld contended, %.1f ms waited\n", best->file, best->line,
+                    (long long)atomic_load(&best->acquisitions), (long long)atomic_load(&best->contended),
+                    atomic_load(&best->wait_ns) / 1e6);
+        }
+    }
+}
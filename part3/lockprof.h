@@ -0,0 +1,55 @@
+#ifndef LOCKPROF_H
+#define LOCKPROF_H
+
+//lock contention profiler for the threaded park, built with -DLOCK_PROFILE (make park_lockprof)
+//prof_lock/prof_unlock/prof_wait/prof_timedwait stand in for the pthread calls, prof_name gives a mutex a report name
+//profiled, every acquisition is counted per lock and per call site, with wait (contended only) and hold time histograms
+//prof_report prints the table on stderr at exit
+//without the flag they are the plain pthread calls and prof_name/prof_report are empty, so nothing is left to pay
+
+#include <pthread.h>
+#include <time.h>
+
+#ifdef LOCK_PROFILE
+
+#include <stdatomic.h>
+
+typedef struct LockSite {
+    const char* file;
+    int line;
+    atomic_int registered;
+    int group;
+    atomic_llong acquisitions;
+    atomic_llong contended;
+    atomic_llong wait_ns;
+    struct LockSite* next;
+} LockSite;
+
+void lockprof_name(pthread_mutex_t* mutex, const char* name);
+void lockprof_lock(pthread_mutex_t* mutex, LockSite* site);
+void lockprof_unlock(pthread_mutex_t* mutex);
+int lockprof_wait(pthread_cond_t* cond, pthread_mutex_t* mutex, const struct timespec* deadline, LockSite* site);
+void lockprof_report(void);
+
+//one static LockSite per call site, registered the first time it runs
+#define LOCKPROF_SITE static LockSite site_ = { __FILE__, __LINE__, 0, 0, 0, 0, 0, NULL }
+
+#define prof_name(m, name) lockprof_name(m, name)
+#define prof_lock(m) do { LOCKPROF_SITE; lockprof_lock(m, &site_); } while (0)
+#define prof_unlock(m) lockprof_unlock(m)
+#define prof_wait(c, m) do { LOCKPROF_SITE; lockprof_wait(c, m, NULL, &site_); } while (0)
+#define prof_timedwait(c, m, t) ({ LOCKPROF_SITE; lockprof_wait(c, m, t, &site_); })
+#define prof_report() lockprof_report()
+
+#else
+
+#define prof_name(m, name) ((void)0)
+#define prof_lock(m) pthread_mutex_lock(m)
+#define prof_unlock(m) pthread_mutex_unlock(m)
+#define prof_wait(c, m) pthread_cond_wait(c, m)
+#define prof_timedwait(c, m, t) pthread_cond_timedwait(c, m, t)
+#define prof_report() ((void)0)
+
+#endif
+
+#endif
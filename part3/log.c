@@ -0,0 +1,299 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include "park.h"
+#include "log.h"
+#include "trace.h"
+
+#define LOG_RING_SIZE 256 // records per thread, a power of two
+#define LOG_FLUSH_NS 5000000L // writer thread wakes up this often
+
+typedef struct {
+    int64_t time;  // ns since the park opened
+    uint32_t seq;  // position in its ring, keeps records of one thread in order
+    uint16_t ring;
+    uint16_t type;
+    int args[4];
+} LogRecord;
+
+//single producer (the owning thread), single consumer (whoever holds drain_mutex)
+typedef struct LogRing {
+    LogRecord records[LOG_RING_SIZE];
+    _Alignas(64) atomic_uint head; // next slot the owner writes
+    _Alignas(64) atomic_uint tail; // next slot the writer reads
+    int id;
+    struct LogRing* next;
+} LogRing;
+
+int log_level = LOG_ALL;   // what gets recorded, everything while tracing
+static int print_level = LOG_ALL; // what gets printed
+
+const int log_type_level[LOG_NUM_TYPES] = {
+    [LOG_EXPLORING] = LOG_ALL,
+    [LOG_GETTING_TICKET] = LOG_ALL,
+    [LOG_GOT_TICKET] = LOG_ALL,
+    [LOG_BOARDED] = LOG_ALL,
+    [LOG_UNBOARDED] = LOG_ALL,
+    [LOG_CAR_LOADING] = LOG_CARS,
+    [LOG_CAR_TIMEOUT] = LOG_CARS,
+    [LOG_CAR_RUNNING] = LOG_CARS,
+    [LOG_CAR_UNLOADED] = LOG_CARS,
+    [LOG_CAR_EXITING] = LOG_CARS,
+    [LOG_SIM_ENDED] = LOG_STATS,
+    [LOG_ARRIVED] = LOG_ALL,
+    [LOG_LEFT] = LOG_ALL,
+};
+
+static const char* formats[LOG_NUM_TYPES] = {
+    [LOG_EXPLORING] = "Passenger %d exploring for %d seconds!\n",
+    [LOG_GETTING_TICKET] = "Passenger %d getting ticket at booth %d!\n",
+    [LOG_GOT_TICKET] = "Passenger %d got ticket!\n",
+    [LOG_BOARDED] = "Passenger %d boarded car %d (%d/%d)\n",
+    [LOG_UNBOARDED] = "Passenger %d unboarded car!\n",
+    [LOG_CAR_LOADING] = "Car %d loading passengers at platform %d!\n",
+    [LOG_CAR_TIMEOUT] = "[Car %d] Timed out with %d/%d passengers\n",
+    [LOG_CAR_RUNNING] = "[Car %d] Running ride...\n",
+    [LOG_CAR_UNLOADED] = "[Car %d] Unloading complete\n",
+    [LOG_CAR_EXITING] = "Car %d exiting\n",
+    [LOG_SIM_ENDED] = "Simulation ended\n",
+    [LOG_ARRIVED] = "Passenger %d arrived (guest %d)\n",
+    [LOG_LEFT] = "Passenger %d left the park\n",
+};
+
+static _Atomic(LogRing*) rings = NULL;
+static atomic_int ring_count;
+static __thread LogRing* my_ring = NULL;
+
+static pthread_mutex_t drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LogRecord* batch = NULL;
+static int batch_size = 0;
+static char* out = NULL;
+static size_t out_size = 0;
+
+static FILE* trace_file = NULL;
+static TraceRecord* trace_batch = NULL;
+static int trace_size = 0;
+
+static atomic_int writer_running;
+static pthread_t writer_tid;
+
+static LogRing* register_ring(void) {
+    LogRing* ring = calloc(1, sizeof(LogRing));
+    if (!ring) {
+        perror("calloc");
+        exit(1);
+    }
+    ring->id = atomic_fetch_add(&ring_count, 1);
+    ring->next = atomic_load(&rings);
+    while (!atomic_compare_exchange_weak(&rings, &ring->next, ring)) {
+    }
+    return ring;
+}
+
+void log_push(int type, int a, int b, int c, int d) {
+    LogRing* ring = my_ring;
+    if (!ring) {
+        ring = my_ring = register_ring();
+    }
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    //a full ring waits for the writer rather than dropping lines
+    while (head - atomic_load_explicit(&ring->tail, memory_order_acquire) == LOG_RING_SIZE) {
+        sched_yield();
+    }
+    LogRecord* rec = &ring->records[head % LOG_RING_SIZE];
+    rec->time = park_clock();
+    rec->seq = head;
+    rec->ring = ring->id;
+    rec->type = type;
+    rec->args[0] = a;
+    rec->args[1] = b;
+    rec->args[2] = c;
+    rec->args[3] = d;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static int record_before(const void* pa, const void* pb) {
+    const LogRecord* a = pa;
+    const LogRecord* b = pb;
+    if (a->time != b->time) return a->time < b->time ? -1 : 1;
+    if (a->ring != b->ring) return a->ring < b->ring ? -1 : 1;
+    return a->seq < b->seq ? -1 : (a->seq > b->seq);
+}
+
+//must hold drain_mutex
+static int collect(void) {
+    int n = 0;
+    for (LogRing* ring = atomic_load(&rings); ring; ring = ring->next) {
+        unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (n + (int)(head - tail) > batch_size) {
+            batch_size = (n + (head - tail)) * 2;
+            batch = realloc(batch, sizeof(LogRecord) * batch_size);
+            if (!batch) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        for (; tail != head; ++tail) {
+            batch[n++] = ring->records[tail % LOG_RING_SIZE];
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+    return n;
+}
+
+static void to_trace(const LogRecord* rec, TraceRecord* t) {
+    memset(t, 0, sizeof(*t));
+    t->time = rec->time;
+    t->type = rec->type;
+    t->entity = rec->args[0];
+    switch (rec->type) {
+        case LOG_BOARDED:
+            t->car = rec->args[1];
+            t->value = rec->args[2];
+            t->capacity = rec->args[3];
+            break;
+        case LOG_CAR_TIMEOUT:
+            t->car = rec->args[0];
+            t->value = rec->args[1];
+            t->capacity = rec->args[2];
+            break;
+        case LOG_CAR_LOADING:
+        case LOG_CAR_RUNNING:
+        case LOG_CAR_UNLOADED:
+        case LOG_CAR_EXITING:
+            t->car = rec->args[0];
+            t->value = rec->args[1];
+            break;
+        default:
+            t->value = rec->args[1];
+            break;
+    }
+}
+
+//must hold drain_mutex
+static void write_trace(int n) {
+    if (n > trace_size) {
+        trace_size = n * 2;
+        trace_batch = realloc(trace_batch, sizeof(TraceRecord) * trace_size);
+        if (!trace_batch) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        to_trace(&batch[i], &trace_batch[i]);
+    }
+    fwrite(trace_batch, sizeof(TraceRecord), n, trace_file);
+}
+
+//must hold drain_mutex
+static void write_batch(int n) {
+    qsort(batch, n, sizeof(LogRecord), record_before);
+    if (trace_file) {
+        write_trace(n);
+    }
+    size_t len = 0;
+    for (int i = 0; i < n; ++i) {
+        if (out_size - len < 128) {
+            out_size = out_size ? out_size * 2 : 65536;
+            out = realloc(out, out_size);
+            if (!out) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        const LogRecord* rec = &batch[i];
+        if (log_type_level[rec->type] > print_level) {
+            continue; // recorded for the trace only
+        }
+        int total_time = rec->time / NS_PER_SEC;
+        len += snprintf(out + len, out_size - len, "[Time: %02d:%02d:%02d] ",
+                        total_time / 3600, (total_time % 3600) / 60, total_time % 60);
+        len += snprintf(out + len, out_size - len, formats[rec->type],
+                        rec->args[0], rec->args[1], rec->args[2], rec->args[3]);
+    }
+    fwrite(out, 1, len, stdout);
+}
+
+void log_flush(void) {
+    pthread_mutex_lock(&drain_mutex);
+    int n;
+    while ((n = collect()) > 0) {
+        write_batch(n);
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&drain_mutex);
+}
+
+static void* writer_thread(void* arg) {
+    (void)arg;
+    struct timespec pause = { 0, LOG_FLUSH_NS };
+    while (atomic_load(&writer_running)) {
+        nanosleep(&pause, NULL);
+        pthread_mutex_lock(&drain_mutex);
+        int n = collect();
+        if (n > 0) {
+            write_batch(n);
+        }
+        pthread_mutex_unlock(&drain_mutex);
+    }
+    return NULL;
+}
+
+int log_trace_open(const char* path, uint64_t seed) {
+    trace_file = fopen(path, "wb");
+    if (!trace_file) {
+        perror(path);
+        return -1;
+    }
+    setvbuf(trace_file, NULL, _IOFBF, 1 << 20);
+    TraceHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.record_size = sizeof(TraceRecord);
+    header.seed = seed;
+    fwrite(&header, sizeof(header), 1, trace_file);
+    return 0;
+}
+
+void log_init(int level) {
+    print_level = level;
+    log_level = trace_file ? LOG_ALL : level;
+    atomic_store(&writer_running, 1);
+    pthread_create(&writer_tid, NULL, writer_thread, NULL);
+}
+
+void log_shutdown(void) {
+    atomic_store(&writer_running, 0);
+    pthread_join(writer_tid, NULL);
+    log_flush();
+
+    LogRing* ring = atomic_exchange(&rings, NULL);
+    while (ring) {
+        LogRing* next = ring->next;
+        free(ring);
+        ring = next;
+    }
+    my_ring = NULL;
+    if (trace_file) {
+        if (fclose(trace_file)) {
+            perror("trace");
+        }
+        trace_file = NULL;
+    }
+    free(trace_batch);
+    trace_batch = NULL;
+    trace_size = 0;
+    free(batch);
+    free(out);
+    batch = NULL;
+    out = NULL;
+    batch_size = 0;
+    out_size = 0;
+}
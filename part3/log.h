@@ -0,0 +1,51 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdint.h>
+
+//event log, threads write fixed size records into their own ring buffer without locking
+//one writer thread formats the records and writes them to stdout in batches
+
+typedef enum {
+    LOG_STATS,  // monitor and final statistics only
+    LOG_CARS,   // plus car events
+    LOG_ALL     // plus every passenger event (default)
+} LogLevel;
+
+typedef enum {
+    LOG_EXPLORING,      // passenger, seconds
+    LOG_GETTING_TICKET, // passenger, booth
+    LOG_GOT_TICKET,     // passenger
+    LOG_BOARDED,        // passenger, car, boarded, capacity
+    LOG_UNBOARDED,      // passenger
+    LOG_CAR_LOADING,    // car, platform
+    LOG_CAR_TIMEOUT,    // car, boarded, capacity
+    LOG_CAR_RUNNING,    // car
+    LOG_CAR_UNLOADED,   // car
+    LOG_CAR_EXITING,    // car
+    LOG_SIM_ENDED,
+    LOG_ARRIVED,        // passenger, guest
+    LOG_LEFT,           // passenger
+    LOG_NUM_TYPES
+} LogType;
+
+extern int log_level;
+extern const int log_type_level[LOG_NUM_TYPES];
+
+//records every event into a binary trace (trace.h) as well, call before log_init
+int log_trace_open(const char* path, uint64_t seed);
+void log_init(int level);
+void log_shutdown(void);
+void log_push(int type, int a, int b, int c, int d);
+
+//writes out everything logged so far, call before printing to stdout directly
+void log_flush(void);
+
+//ids are printed as given, callers pass the same 1-based numbers the text shows
+static inline void log_event(int type, int a, int b, int c, int d) {
+    if (log_type_level[type] <= log_level) {
+        log_push(type, a, b, c, d);
+    }
+}
+
+#endif
@@ -0,0 +1,286 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "sim.h"
+#include "log.h"
+#include "sweep.h"
+
+//capacity planner (--optimize), the cheapest fleets that keep the p95 ride wait under --sla seconds
+//the search space is the -c, -p and -w lists in sweep syntax (-c 1:40 -p 4,8,12 -w 5:30:5), the other settings are fixed
+//a fleet costs its seats, cars * capacity
+//for each capacity and wait a bisection over the cars finds the fewest that meet the SLA, more cars never make the wait worse
+//the searches run side by side on -t threads, every probe is a quiet virtual time park on the same seed
+//a probe closes early once its outcome is clear (probe_check)
+//prints every probe as CSV with the Pareto set of cost against p95 wait marked, and the cheapest fleet on stderr
+
+#define CHECK_INTERVAL (600 * NS_PER_SEC) // park time between early checks
+#define MIN_SAMPLES 200                   // ride waits before a probe may close early
+
+typedef struct {
+    ParkConfig cfg;
+    int done;
+    int failed;
+    int meets;
+    int early;  // closed early, the figures are from the part of the day that ran
+    int pareto;
+    double p95; // seconds
+    double riders_per_hour;
+} Probe;
+
+//one capacity and wait, a probe slot per car count, filled as the bisection asks
+typedef struct {
+    Probe* probes;
+} Search;
+
+typedef struct {
+    Search* searches;
+    int num_searches;
+    atomic_int next;
+    Axis cars;
+    Axis capacity;
+    Axis wait;
+} Optimizer;
+
+static double sla_seconds;
+
+//p95 of the ride waits so far, passengers still in line count with what they waited up to now
+static double ride_wait_p95(Sim* sim, uint64_t* samples) {
+    HistSnapshot* hists = malloc(sizeof(HistSnapshot) * NUM_LATENCIES);
+    Histogram* queued = malloc(sizeof(Histogram));
+    if (!hists || !queued) {
+        perror("malloc");
+        exit(1);
+    }
+    ParkStats s;
+    stats_read_hist(sim->stats, &s, hists);
+    hist_init(queued);
+    sim_queued_waits(sim, queued);
+    hist_merge(&hists[LAT_RIDE_WAIT], queued);
+    double p95 = hist_ms(hist_percentile(&hists[LAT_RIDE_WAIT], 95)) / 1e3;
+    *samples = hists[LAT_RIDE_WAIT].total;
+    free(queued);
+    free(hists);
+    return p95;
+}
+
+//after the first quarter of the day, twice the SLA already fails a probe and half of it passes
+static int probe_check(Sim* sim, void* ctx) {
+    Probe* probe = ctx;
+    if (sim_now < sim->end / 4) {
+        return 0;
+    }
+    uint64_t samples;
+    double p95 = ride_wait_p95(sim, &samples);
+    if (samples < MIN_SAMPLES || (p95 < 2 * sla_seconds && p95 > sla_seconds / 2)) {
+        return 0;
+    }
+    probe->early = 1;
+    return 1;
+}
+
+static void run_probe(Probe* probe) {
+    Sim sim;
+    probe->done = 1;
+    probe->failed = 1;
+    if (sim_init(&sim, &probe->cfg)) {
+        return;
+    }
+    sim.quiet = 1;
+    sim.check = probe_check;
+    sim.check_ctx = probe;
+    sim.check_interval = CHECK_INTERVAL;
+    if (sim_run_virtual(&sim) == 0) {
+        uint64_t samples;
+        ParkStats s;
+        probe->p95 = ride_wait_p95(&sim, &samples);
+        sim_snapshot(&sim, &s);
+        probe->riders_per_hour = sim_now > 0 ? s.passengers_served / (sim_now / 3600e9) : 0;
+        probe->meets = probe->p95 <= sla_seconds;
+        probe->failed = 0;
+    }
+    sim_free(&sim);
+}
+
+static Probe* get_probe(Optimizer* opt, int search, int car) {
+    Probe* probe = &opt->searches[search].probes[car];
+    if (!probe->done) {
+        run_probe(probe);
+    }
+    return probe;
+}
+
+static void* optimize_thread(void* arg) {
+    Optimizer* opt = arg;
+    int i;
+    while ((i = atomic_fetch_add(&opt->next, 1)) < opt->num_searches) {
+        //the most cars first, if even they miss the SLA no smaller fleet meets it
+        int lo = 0, hi = opt->cars.count - 1;
+        if (!get_probe(opt, i, hi)->meets) {
+            continue;
+        }
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (get_probe(opt, i, mid)->meets) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+    }
+    set_virtual_clock(NULL);
+    return NULL;
+}
+
+static int cost(const Probe* p) {
+    return p->cfg.cars * p->cfg.capacity;
+}
+
+static int by_cost(const void* a, const void* b) {
+    const Probe* x = *(const Probe* const*)a;
+    const Probe* y = *(const Probe* const*)b;
+    if (cost(x) != cost(y)) {
+        return cost(x) - cost(y);
+    }
+    return (x->p95 > y->p95) - (x->p95 < y->p95);
+}
+
+static int compare_ints(const void* a, const void* b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+//ascending without repeats, the bisection needs the cars in order
+static void sort_axis(Axis* axis) {
+    qsort(axis->values, axis->count, sizeof(int), compare_ints);
+    int n = 0;
+    for (int i = 0; i < axis->count; ++i) {
+        if (n == 0 || axis->values[i] != axis->values[n - 1]) {
+            axis->values[n++] = axis->values[i];
+        }
+    }
+    axis->count = n;
+}
+
+static int load_axis(Axis* axis, const char* spec, int value) {
+    if (spec ? parse_axis(axis, spec) : 0) {
+        return -1;
+    }
+    if (axis->count == 0) {
+        axis_add(axis, value);
+    }
+    sort_axis(axis);
+    return 0;
+}
+
+int run_optimize(const ParkConfig* base, const char* specs[], double sla) {
+    if (base->num_attractions > 0) {
+        fprintf(stderr, "--optimize searches the -c/-p/-w fleet of a single ride, not an attraction file\n");
+        return 1;
+    }
+    Optimizer opt;
+    memset(&opt, 0, sizeof(opt));
+    if (load_axis(&opt.cars, specs['c'], base->cars) ||
+        load_axis(&opt.capacity, specs['p'], base->capacity) ||
+        load_axis(&opt.wait, specs['w'], base->wait_seconds)) {
+        return 1;
+    }
+    sla_seconds = sla;
+
+    opt.num_searches = opt.capacity.count * opt.wait.count;
+    opt.searches = calloc(opt.num_searches, sizeof(Search));
+    if (!opt.searches) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < opt.num_searches; ++i) {
+        Search* search = &opt.searches[i];
+        search->probes = calloc(opt.cars.count, sizeof(Probe));
+        if (!search->probes) {
+            perror("calloc");
+            return 1;
+        }
+        for (int c = 0; c < opt.cars.count; ++c) {
+            ParkConfig* cfg = &search->probes[c].cfg;
+            *cfg = *base;
+            cfg->cars = opt.cars.values[c];
+            cfg->capacity = opt.capacity.values[i / opt.wait.count];
+            cfg->wait_seconds = opt.wait.values[i % opt.wait.count];
+        }
+    }
+    atomic_init(&opt.next, 0);
+
+    //probes print nothing while they go
+    log_level = LOG_STATS;
+    int num_threads = sweep_threads(opt.num_searches);
+    pthread_t* threads = malloc(sizeof(pthread_t) * num_threads);
+    if (!threads) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_create(&threads[i], NULL, optimize_thread, &opt);
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    int total = opt.num_searches * opt.cars.count;
+    Probe** ran = malloc(sizeof(Probe*) * total);
+    if (!ran) {
+        perror("malloc");
+        exit(1);
+    }
+    int num_ran = 0;
+    int failed = 0;
+    for (int i = 0; i < opt.num_searches; ++i) {
+        for (int c = 0; c < opt.cars.count; ++c) {
+            Probe* p = &opt.searches[i].probes[c];
+            if (p->done && !p->failed) {
+                ran[num_ran++] = p;
+            } else if (p->done) {
+                failed = 1;
+            }
+        }
+    }
+    qsort(ran, num_ran, sizeof(Probe*), by_cost);
+
+    //sorted by cost and then wait, a probe is on the front if it waits less than everything before it
+    double best_p95 = 0;
+    for (int i = 0; i < num_ran; ++i) {
+        if (i == 0 || ran[i]->p95 < best_p95) {
+            ran[i]->pareto = 1;
+            best_p95 = ran[i]->p95;
+        }
+    }
+
+    printf("cars,capacity,wait,cost,ride_wait_p95_s,riders_per_hour,meets_sla,early,pareto\n");
+    const Probe* cheapest = NULL;
+    for (int i = 0; i < num_ran; ++i) {
+        const Probe* p = ran[i];
+        printf("%d,%d,%d,%d,%.1f,%.1f,%d,%d,%d\n", p->cfg.cars, p->cfg.capacity, p->cfg.wait_seconds, cost(p),
+               p->p95, p->riders_per_hour, p->meets, p->early, p->pareto);
+        if (p->meets && !cheapest) {
+            cheapest = p;
+        }
+    }
+    if (cheapest) {
+        fprintf(stderr, "Cheapest fleet with p95 ride wait under %g s: %d cars of %d seats, wait %d s (%d seats, p95 %.1f s)\n",
+                sla, cheapest->cfg.cars, cheapest->cfg.capacity, cheapest->cfg.wait_seconds, cost(cheapest),
+                cheapest->p95);
+    } else {
+        fprintf(stderr, "No fleet in the search space keeps p95 ride wait under %g s\n", sla);
+    }
+
+    free(ran);
+    free(threads);
+    for (int i = 0; i < opt.num_searches; ++i) {
+        free(opt.searches[i].probes);
+    }
+    free(opt.searches);
+    free(opt.cars.values);
+    free(opt.capacity.values);
+    free(opt.wait.values);
+    return failed;
+}
@@ -1,304 +1,937 @@
 #define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <unistd.h>
 #include <pthread.h>
-#include <errno.h>
+#include <semaphore.h>
 #include <time.h>
 #include <getopt.h>
+#include <stddef.h>
+#include "park.h"
+#include "stats.h"
+#include "log.h"
+#include "rng.h"
+#include "export.h"
+#include "dispatch.h"
+#include "timer.h"
+#include "guests.h"
+#include "lockprof.h"
+#include "placement.h"
+#include "../bench/bench.h"
 
 //same as part 2, but with the new addition of monitor statistics. They have to be in interval, and then a final statistic print at the end of the simulation.
-
-#define MAX_CAPACITY 100
-#define MONITOR_INTERVAL 5 // Print stats every 5 seconds
+//-v runs the same logic on a virtual clock instead (sim.c), so a long day takes seconds
+//-m runs passengers as state records on a fixed pool of worker threads (pool.c) instead of a thread each
+//--sweep runs every combination of list/range settings (-c 1:8 -p 5,10) as parallel virtual time parks and prints CSV (sweep.c)
+//--optimize searches -c/-p/-w lists for the cheapest fleets with a p95 ride wait under --sla seconds (optimize.c)
+//--seed fixes the random streams, the virtual clock version then gives the same statistics on every run
+//--export publishes the live statistics in shared memory every --export-interval ms (export.c), park-top shows them
+//--trace also writes every event to a binary file (trace.h), park-analyze recomputes the statistics from it (analyze.c)
+//explore, ticket and ride delays and the car load timeouts are timers on one CLOCK_MONOTONIC wheel (timer.c), not a kernel timer each
+//built with -DBENCH (make park_bench) the explore/ticket/ride sleeps only yield, for timing the locking
+//-L picks how much of the event log is printed, 0 is statistics only, the log itself is written by log.c off the hot path
+//each car has its own lock and condition variables, up to NUM_PLATFORMS cars load at the same time
+//passengers wait for a seat in a FIFO line, a loading car hands seats to the front of it and wakes only those passengers
+//tickets are sold at NUM_BOOTHS booths from one FIFO line, the office lock is never held while selling
+//locking goes through lockprof.h, make park_lockprof reports contention per lock and call site at exit
+//--arrivals opens the park to guests arriving on a daily schedule, each leaves after about --rides rides (sim.c)
+//-D picks when a car that is not full leaves (dispatch.c), --threshold and --target tune the queue and sla policies
+//-A loads several attractions from a file (see attractions.c), only the event driven versions (-v, -m, --sweep) run them
+//the monitor also scans a per guest table (guests.c) for rides and time in lines per guest and how fairly they are spread
+//--shards splits the -A attractions of a virtual time park over several processes, guests walk between them (shard.c)
+//car and passenger threads get --stack-size KB stacks and are started by several spawner threads when there are many of them,
+//closing time wakes every timer at once (timer_wheel_close), the final report gives how long both took
+//--fastpass gives that percentage of passengers a fast-pass, they wait for a seat in a lane of their own and a loading car
+//takes --fastpass-ratio fast-pass:standby riders in turn from the two lanes, or from whichever lane is not empty
+//--cpus-cars, --cpus-passengers and --cpus-monitor pin those threads to cpu lists, the car table is placed near the cars (placement.c)
+//--checkpoint saves a -v park every --checkpoint-interval seconds of park time and on SIGUSR1, --restore carries on from one (checkpoint.c)
 
 int NUM_PASSENGERS = 10;
 int NUM_CARS = 1;
 int CAR_CAPACITY = 5;
 int WAIT_SECONDS = 8;
 int RIDE_SECONDS = 6;
+int NUM_PLATFORMS = 1;
+int NUM_BOOTHS = 1;
+int SIM_SECONDS = 10;
+int NUM_WORKERS = 0;
+int VIRTUAL_TIME = 0;
+int WORKER_POOL = 0;
+int LOG_LEVEL = LOG_ALL;
+int SWEEP = 0;
+int REPLICATIONS = 1;
+int OPTIMIZE = 0;
+double SLA_SECONDS = 300;
+uint64_t SEED = 0;
+AttractionConfig* ATTRACTIONS = NULL; // -A, event driven versions only
+int NUM_ATTRACTIONS = 0;
+int PICK_POLICY = PICK_RANDOM;
+ArrivalPoint* ARRIVALS = NULL; // --arrivals, event driven versions only
+int NUM_ARRIVALS = 0;
+int RIDES_PER_VISIT = 4;
+const char* TRACE_PATH = NULL;
+const char* EXPORT_NAME = NULL;
+int EXPORT_INTERVAL_MS = 1000;
+int DISPATCH_POLICY = DISPATCH_TIMEOUT;
+int DISPATCH_THRESHOLD = 0; // half the car
+int TARGET_SECONDS = 30;
+const char* CHECKPOINT_PATH = NULL;
+int CHECKPOINT_INTERVAL = 3600;
+const char* RESTORE_PATH = NULL;
+int SHARDS = 1;
+int FASTPASS_PERCENT = 0; // threaded version only
+int FASTPASS_SEATS = 3;   // --fastpass-ratio, out of every FASTPASS_SEATS + STANDBY_SEATS seats of a car
+int STANDBY_SEATS = 2;
+int STACK_KB = 64; // car and passenger threads, they keep a few small records on the stack
 
-pthread_mutex_t ticket_mutex = PTHREAD_MUTEX_INITIALIZER;
 static struct timespec start_time;
+static clockid_t log_clock = CLOCK_MONOTONIC_COARSE; // precise while tracing
+static __thread const int64_t* virtual_clock = NULL;
 
 // monitor statistics
-int total_passengers_served = 0;
-int total_rides_completed = 0;
-double total_ticket_wait = 0;
-double total_ride_wait = 0;
-int total_ticket_requests = 0;
-int total_ride_requests = 0;
+Stats stats;
+Histogram class_waits[NUM_GUEST_CLASSES]; // ride wait per guest class
+GuestTable guest_table; // passenger id - 1 is the guest number
 
+//one per car, passengers riding a car only ever touch its lock
 typedef struct {
+    int id;
     int passengers_boarded;
     int passengers_unboarded;
-    int car_capacity;
-    int car_id;
     int loading;
     int unloading;
-    int ready;
     int running;
+    int64_t first_ticket; // earliest ticket of the passengers aboard, ns on CLOCK_MONOTONIC
+    Timer load_timer;     // wakes the car when the -D policy says to leave
     pthread_mutex_t mutex;
     pthread_cond_t car_unloading;
-    pthread_cond_t car_loading;
     pthread_cond_t car_ready_to_run;
+} CarState;
+
+//a passenger in line for a seat, lives on the passenger's stack
+//the car that takes it sets car and posts ready, so only passengers that get a seat wake up
+typedef struct Waiter {
+    CarState* car; // NULL if the park closed first
+    int guest_class;
+    sem_t ready;
+    struct Waiter* next;
+} Waiter;
+
+//one FIFO lane per guest class
+typedef struct {
+    Waiter* head;
+    Waiter* tail;
+} Lane;
+
+//a loading platform, seats are claimed under state.mutex and filled under the car's mutex
+typedef struct {
+    CarState* car; // NULL when the platform is free
+    int seats;     // seats not claimed yet
+} Platform;
+
+typedef struct {
+    int running;
+    int free_platforms;
+    Platform* platforms;
+    pthread_mutex_t mutex;
+    Lane lanes[NUM_GUEST_CLASSES]; // passengers waiting for a seat
+    int waiting;                   // in all lanes
+    pthread_cond_t platform_free; // cars wait here for a platform
+    ArrivalRate line_rate;        // passengers coming for a seat, updated under mutex
 } ParkState;
 
+//one shared line in front of all booths, passengers take a number and go to the first free booth in order
+typedef struct {
+    int open;
+    int next_ticket;  // number for the next passenger joining the line
+    int now_serving;  // lowest number that has not reached a booth yet
+    int free_booths;
+    int* busy;        // 1 while the booth is selling
+    BoothStats* stats;
+    pthread_mutex_t mutex;
+    pthread_cond_t booth_free;
+} TicketOffice;
+
 ParkState state;
+CarState* cars;
+TicketOffice office;
+DispatchConfig dispatch;
 
-void print_time() {
+static int64_t elapsed_ns(const struct timespec* from, const struct timespec* to) {
+    return (to->tv_sec - from->tv_sec) * NS_PER_SEC + (to->tv_nsec - from->tv_nsec);
+}
+
+static int64_t timespec_ns(const struct timespec* t) {
+    return t->tv_sec * NS_PER_SEC + t->tv_nsec;
+}
+
+//model delays wait on the timer wheel, the bench build only yields
+static void park_sleep(int seconds) {
+#ifdef BENCH
+    model_sleep(seconds);
+#else
+    timer_sleep(seconds * NS_PER_SEC);
+#endif
+}
+
+//the car loop works out again whether to leave, so a timeout that was replaced meanwhile does no harm
+static void car_timeout(Timer* t) {
+    CarState* car = (CarState*)((char*)t - offsetof(CarState, load_timer));
+    prof_lock(&car->mutex);
+    pthread_cond_signal(&car->car_ready_to_run);
+    prof_unlock(&car->mutex);
+}
+
+ParkConfig park_config(void) {
+    ParkConfig cfg = {
+        NUM_PASSENGERS, NUM_CARS, CAR_CAPACITY, WAIT_SECONDS, RIDE_SECONDS,
+        NUM_PLATFORMS, NUM_BOOTHS, SIM_SECONDS, SEED,
+        ATTRACTIONS, NUM_ATTRACTIONS, PICK_POLICY,
+        ARRIVALS, NUM_ARRIVALS, RIDES_PER_VISIT,
+        DISPATCH_POLICY, DISPATCH_THRESHOLD, TARGET_SECONDS
+    };
+    return cfg;
+}
+
+void set_virtual_clock(const int64_t* now_ns) {
+    virtual_clock = now_ns;
+}
+
+//coarse clock, log lines only show whole seconds and this one is far cheaper to read
+//a trace keeps nanoseconds, so --trace switches to the precise clock
+int64_t park_clock(void) {
+    if (virtual_clock) {
+        return *virtual_clock;
+    }
     struct timespec now;
-    clock_gettime(CLOCK_REALTIME, &now);
-    int total_time = now.tv_sec - start_time.tv_sec;
+    clock_gettime(log_clock, &now);
+    return elapsed_ns(&start_time, &now);
+}
+
+void print_time() {
+    int total_time = park_clock() / NS_PER_SEC;
     int hh = total_time / 3600;
     int mm = (total_time % 3600) / 60;
     int ss = total_time % 60;
     printf("[Time: %02d:%02d:%02d] ", hh, mm, ss);
 }
 
+void print_monitor_stats(const ParkStats* s, const GuestSummary* g) {
+    int rides = s->rides_completed;
+    int passengers = s->passengers_served;
+    double avg_tkt = s->ticket_requests ? s->ticket_wait / s->ticket_requests : 0;
+    double avg_ride = s->ride_requests ? s->ride_wait / s->ride_requests : 0;
+    double util = s->seats_offered ? (100.0 * passengers) / s->seats_offered : 0;
+    double avg_passengers = rides ? (1.0 * passengers) / rides : 0;
+    double avg_seats = rides ? (1.0 * s->seats_offered) / rides : CAR_CAPACITY; // nothing left yet, show the -p setting
+
+    log_flush();
+    print_time();
+    printf("[Monitor] Current Statistics:\n");
+    print_time();
+    printf("  Total passengers served: %d\n", passengers);
+    print_time();
+    printf("  Total rides completed: %d\n", rides);
+    print_time();
+    printf("  Avg ticket wait: %.1f ms\n", avg_tkt);
+    print_time();
+    printf("  Avg ride wait: %.1f ms\n", avg_ride);
+    print_time();
+    printf("  Car utilization: %.0f%% (%.1f/%g passengers)\n", 
+           util, avg_passengers, avg_seats);
+    for (int m = 0; m < NUM_LATENCIES; ++m) {
+        print_time();
+        print_latency(m, &s->latency[m]);
+    }
+    print_time();
+    printf("  Guests exploring/ticket line/ride line/riding/left: %d/%d/%d/%d/%d\n", g->phases[GUEST_EXPLORING],
+           g->phases[GUEST_TICKET], g->phases[GUEST_QUEUED], g->phases[GUEST_RIDING], g->phases[GUEST_LEFT]);
+    print_time();
+    printf("  Rides per guest avg/p50/p90/max: %.1f/%d/%d/%d, fairness %.2f\n", g->rides_avg, g->rides_p50,
+           g->rides_p90, g->rides_max, g->rides_fairness);
+    print_time();
+    printf("  Time in lines per guest avg/p50/p90/max: %.1f/%.1f/%.1f/%.1f s, fairness %.2f\n", g->wait_avg,
+           g->wait_p50, g->wait_p90, g->wait_max, g->wait_fairness);
+}
+
+//ride wait percentiles per --fastpass class
+static void print_class_waits(int timestamp) {
+    static const char* names[NUM_GUEST_CLASSES] = { [GUEST_STANDBY] = "standby", [GUEST_FASTPASS] = "fast-pass" };
+    for (int c = NUM_GUEST_CLASSES - 1; c >= 0; --c) {
+        HistSnapshot h;
+        hist_clear(&h);
+        hist_merge(&h, &class_waits[c]);
+        if (timestamp) {
+            print_time();
+        }
+        printf("  Ride wait %s p50/p90/p99/max: ", names[c]);
+        const double percentiles[] = { 50, 90, 99 };
+        for (int i = 0; i < 3; ++i) {
+            hist_print_ms(0, hist_ms(hist_percentile(&h, percentiles[i])));
+            printf("/");
+        }
+        printf("%.1f ms (%llu riders)\n", h.max / 1e6, (unsigned long long)h.total);
+    }
+}
+
 //monitor thread function 
 void* monitor_thread(void* arg) {
     (void)arg; 
     while (1) {
-        sleep(MONITOR_INTERVAL);
+        timer_sleep(MONITOR_INTERVAL * NS_PER_SEC);
         
-        pthread_mutex_lock(&state.mutex);
+        prof_lock(&state.mutex);
         int running = state.running;
-        pthread_mutex_unlock(&state.mutex);
+        prof_unlock(&state.mutex);
         if (!running) break;
 
-        pthread_mutex_lock(&ticket_mutex);
-        int rides = total_rides_completed;
-        int passengers = total_passengers_served;
-        int tkt_req = total_ticket_requests;
-        int ride_req = total_ride_requests;
-        double tkt_wait = total_ticket_wait;
-        double ride_wait = total_ride_wait;
-        pthread_mutex_unlock(&ticket_mutex);
+        ParkStats s;
+        GuestSummary g;
+        stats_read(&stats, &s);
+        guests_scan(&guest_table, timer_now(), &g);
 
-        double avg_tkt = tkt_req ? tkt_wait / tkt_req : 0;
-        double avg_ride = ride_req ? ride_wait / ride_req : 0;
-        double util = rides ? (100.0 * passengers) / (rides * CAR_CAPACITY) : 0;
-        double avg_passengers = rides ? (1.0 * passengers) / rides : 0;
+        print_monitor_stats(&s, &g);
+        if (FASTPASS_PERCENT > 0) {
+            print_class_waits(1);
+        }
+    }
+    placement_thread_done(THREADS_MONITOR);
+    return NULL;
+}
 
-        print_time();
-        printf("[Monitor] Current Statistics:\n");
-        print_time();
-        printf("  Total passengers served: %d\n", passengers);
-        print_time();
-        printf("  Total rides completed: %d\n", rides);
-        print_time();
-        printf("  Avg ticket wait: %.1f ms\n", avg_tkt);
-        print_time();
-        printf("  Avg ride wait: %.1f ms\n", avg_ride);
-        print_time();
-        printf("  Car utilization: %.0f%% (%.1f/%d passengers)\n", 
-               util, avg_passengers, CAR_CAPACITY);
+//must hold state.mutex, returns the car the seat belongs to or NULL if no car has room
+static CarState* claim_seat(void) {
+    for (int i = 0; i < NUM_PLATFORMS; ++i) {
+        Platform* platform = &state.platforms[i];
+        if (platform->car && platform->seats > 0) {
+            platform->seats--;
+            return platform->car;
+        }
     }
     return NULL;
 }
 
+//must hold state.mutex
+static void line_push(Waiter* w) {
+    Lane* lane = &state.lanes[w->guest_class];
+    w->next = NULL;
+    if (lane->tail) {
+        lane->tail->next = w;
+    } else {
+        lane->head = w;
+    }
+    lane->tail = w;
+    state.waiting++;
+}
+
+//must hold state.mutex, seat is the car's how manieth seat handed out this load
+//the first FASTPASS_SEATS of every FASTPASS_SEATS + STANDBY_SEATS go to the fast-pass lane, the rest to standby,
+//a seat whose lane is empty goes to the other one
+static Waiter* line_pop(int seat) {
+    int guest_class = seat % (FASTPASS_SEATS + STANDBY_SEATS) < FASTPASS_SEATS ? GUEST_FASTPASS : GUEST_STANDBY;
+    Lane* lane = &state.lanes[guest_class];
+    if (!lane->head) {
+        lane = &state.lanes[guest_class == GUEST_FASTPASS ? GUEST_STANDBY : GUEST_FASTPASS];
+    }
+    Waiter* w = lane->head;
+    if (w) {
+        lane->head = w->next;
+        if (!lane->head) {
+            lane->tail = NULL;
+        }
+        state.waiting--;
+    }
+    return w;
+}
+
+//takes a seat right away if nobody is in line, otherwise waits for a car to hand one over
+static CarState* wait_for_seat(Waiter* me, int64_t now) {
+    CarState* car = NULL;
+    int queued = 0;
+    prof_lock(&state.mutex);
+    if (state.running) {
+        rate_observe(&state.line_rate, now);
+        if (state.waiting == 0) {
+            car = claim_seat();
+        }
+        if (!car) {
+            line_push(me);
+            queued = 1;
+        }
+    }
+    prof_unlock(&state.mutex);
+    if (queued) {
+        while (sem_wait(&me->ready) != 0) {
+        }
+        car = me->car;
+    }
+    return car;
+}
+
+//waits in line for a free booth, returns it or -1 if the park closed
+static int get_booth(void) {
+    prof_lock(&office.mutex);
+    int number = office.next_ticket++;
+    while (office.open && (number != office.now_serving || office.free_booths == 0)) {
+        prof_wait(&office.booth_free, &office.mutex);
+    }
+    int booth = -1;
+    if (office.open) {
+        booth = 0;
+        while (office.busy[booth]) {
+            booth++;
+        }
+        office.busy[booth] = 1;
+        office.free_booths--;
+        office.now_serving++;
+        //the next in line may fit at another free booth
+        pthread_cond_broadcast(&office.booth_free);
+    }
+    prof_unlock(&office.mutex);
+    return booth;
+}
+
+static void release_booth(int booth, double service_ms) {
+    prof_lock(&office.mutex);
+    office.busy[booth] = 0;
+    office.free_booths++;
+    office.stats[booth].tickets_sold++;
+    office.stats[booth].service_time += service_ms;
+    pthread_cond_broadcast(&office.booth_free);
+    prof_unlock(&office.mutex);
+}
+
 void* passenger_thread(void* arg) {
-    int id = *((int*)arg);
-    free(arg);
+    int id = (intptr_t)arg;
+    Rng rng;
+    rng_seed(&rng, SEED, id - 1);
+    Waiter me;
+    sem_init(&me.ready, 0, 0);
+    me.guest_class = FASTPASS_PERCENT > 0 && rng_range(&rng, 0, 99) < FASTPASS_PERCENT ? GUEST_FASTPASS : GUEST_STANDBY;
 
     while (1) {
-        int explore_time = rand() % 5 + 1;
-        print_time();
-        printf("Passenger %d exploring for %d seconds!\n", id, explore_time);
-        sleep(explore_time);
+        guest_phase(&guest_table, id - 1, GUEST_EXPLORING);
+        int explore_time = rng_range(&rng, 1, 5);
+        log_event(LOG_EXPLORING, id, explore_time, 0, 0);
+        park_sleep(explore_time);
 
         struct timespec ticket_start, ticket_end;
         clock_gettime(CLOCK_MONOTONIC, &ticket_start);
+        guest_joined(&guest_table, id - 1, GUEST_TICKET, timespec_ns(&ticket_start));
 
-        pthread_mutex_lock(&ticket_mutex);
-        print_time();
-        printf("Passenger %d getting ticket!\n", id);
-        sleep(1);
-        pthread_mutex_unlock(&ticket_mutex);
-
+        int booth = get_booth();
+        if (booth < 0) {
+            break;
+        }
+        log_event(LOG_GETTING_TICKET, id, booth + 1, 0, 0);
+        struct timespec service_start;
+        clock_gettime(CLOCK_MONOTONIC, &service_start);
+        park_sleep(1);
         clock_gettime(CLOCK_MONOTONIC, &ticket_end);
-        double ticket_wait = (ticket_end.tv_sec - ticket_start.tv_sec) * 1000 +
-                            (ticket_end.tv_nsec - ticket_start.tv_nsec) / 1e6;
-        pthread_mutex_lock(&ticket_mutex);
-        total_ticket_requests++;
-        total_ticket_wait += ticket_wait;
-        pthread_mutex_unlock(&ticket_mutex);
+        release_booth(booth, elapsed_ns(&service_start, &ticket_end) / 1e6);
+        stats_ticket(&stats, elapsed_ns(&ticket_start, &ticket_end));
+        guest_waited(&guest_table, id - 1, elapsed_ns(&ticket_start, &ticket_end));
 
-        print_time();
-        printf("Passenger %d got ticket!\n", id);
+        log_event(LOG_GOT_TICKET, id, 0, 0, 0);
 
         struct timespec ride_start, ride_end;
         clock_gettime(CLOCK_MONOTONIC, &ride_start);
+        guest_joined(&guest_table, id - 1, GUEST_QUEUED, timespec_ns(&ride_start));
 
-        pthread_mutex_lock(&state.mutex);
-        while (!state.loading && state.running) {
-            pthread_cond_wait(&state.car_loading, &state.mutex);
-        }
-        if (!state.running) {
-            pthread_mutex_unlock(&state.mutex);
+        CarState* car = wait_for_seat(&me, timespec_ns(&ride_start));
+        if (!car) {
             break;
         }
         clock_gettime(CLOCK_MONOTONIC, &ride_end);
-        double ride_wait = (ride_end.tv_sec - ride_start.tv_sec) * 1000 +
-                           (ride_end.tv_nsec - ride_start.tv_nsec) / 1e6;
-        pthread_mutex_lock(&ticket_mutex);
-        total_ride_requests++;
-        total_ride_wait += ride_wait;
-        pthread_mutex_unlock(&ticket_mutex);
-
-        state.passengers_boarded++;
-        print_time();
-        printf("Passenger %d boarded car %d (%d/%d)\n", 
-               id, state.car_id, state.passengers_boarded, CAR_CAPACITY);
-        if (state.passengers_boarded >= CAR_CAPACITY) {
-            pthread_cond_signal(&state.car_ready_to_run);
+        stats_ride_wait(&stats, elapsed_ns(&ride_start, &ride_end));
+        hist_record(&class_waits[me.guest_class], elapsed_ns(&ride_start, &ride_end));
+        guest_waited(&guest_table, id - 1, elapsed_ns(&ride_start, &ride_end));
+        guest_rode(&guest_table, id - 1);
+
+        prof_lock(&car->mutex);
+        if (car->passengers_boarded == 0 || timespec_ns(&ride_start) < car->first_ticket) {
+            car->first_ticket = timespec_ns(&ride_start);
         }
-        pthread_mutex_unlock(&state.mutex);
+        car->passengers_boarded++;
+        log_event(LOG_BOARDED, id, car->id, car->passengers_boarded, CAR_CAPACITY);
+        pthread_cond_signal(&car->car_ready_to_run);
 
-        pthread_mutex_lock(&state.mutex);
-        while (state.running && !state.unloading) {
-            pthread_cond_wait(&state.car_unloading, &state.mutex);
+        while (car->running && !car->unloading) {
+            prof_wait(&car->car_unloading, &car->mutex);
         }
-        if (!state.running) {
-            pthread_mutex_unlock(&state.mutex);
+        if (!car->running) {
+            prof_unlock(&car->mutex);
             break;
         }
-        state.passengers_unboarded++;
-        print_time();
-        printf("Passenger %d unboarded car!\n", id);
-        if (state.passengers_unboarded >= state.passengers_boarded) {
-            pthread_cond_signal(&state.car_unloading);
+        car->passengers_unboarded++;
+        log_event(LOG_UNBOARDED, id, 0, 0, 0);
+        if (car->passengers_unboarded >= car->passengers_boarded) {
+            pthread_cond_signal(&car->car_unloading);
         }
-        pthread_mutex_unlock(&state.mutex);
+        prof_unlock(&car->mutex);
     }
+    sem_destroy(&me.ready);
+    placement_thread_done(THREADS_PASSENGERS);
     return NULL;
 }
 
 void* car_thread(void* arg) {
-    int id = *((int*)arg);
-    free(arg);
+    int id = (intptr_t)arg;
+    CarState* car = &cars[id - 1];
 
     while (1) {
-        pthread_mutex_lock(&state.mutex);
+        struct timespec idle_start, load_start, load_end;
+        clock_gettime(CLOCK_MONOTONIC, &idle_start);
+        prof_lock(&car->mutex);
+        car->loading = 1;
+        car->passengers_boarded = 0;
+        car->passengers_unboarded = 0;
+        prof_unlock(&car->mutex);
+
+        //wait for a free platform
+        prof_lock(&state.mutex);
+        while (state.running && state.free_platforms == 0) {
+            prof_wait(&state.platform_free, &state.mutex);
+        }
         if (!state.running) {
-            pthread_mutex_unlock(&state.mutex);
+            prof_unlock(&state.mutex);
             break;
         }
-        state.loading = 1;
-        state.car_id = id;
-        state.passengers_boarded = 0;
-        state.passengers_unboarded = 0;
-        state.car_capacity = CAR_CAPACITY;
+        int platform = 0;
+        while (state.platforms[platform].car) {
+            platform++;
+        }
+        state.platforms[platform].car = car;
+        state.platforms[platform].seats = CAR_CAPACITY;
+        state.free_platforms--;
+        clock_gettime(CLOCK_MONOTONIC, &load_start);
+        stats_latency(&stats, LAT_CAR_IDLE, elapsed_ns(&idle_start, &load_start));
+
+        log_event(LOG_CAR_LOADING, id, platform + 1, 0, 0);
+        //hand seats to the front of the line, wake them once the lock is dropped
+        Waiter* handed[MAX_CAPACITY];
+        int num_handed = 0;
+        while (state.platforms[platform].seats > 0 && state.waiting > 0 && num_handed < MAX_CAPACITY) {
+            Waiter* w = line_pop(num_handed);
+            w->car = car;
+            state.platforms[platform].seats--;
+            handed[num_handed++] = w;
+        }
+        prof_unlock(&state.mutex);
+        for (int i = 0; i < num_handed; ++i) {
+            sem_post(&handed[i]->ready);
+        }
 
-        print_time();
-        printf("Car %d loading passengers!\n", id);
-        pthread_cond_broadcast(&state.car_loading);
-
-        struct timespec timeout;
-        clock_gettime(CLOCK_REALTIME, &timeout);
-        timeout.tv_sec += WAIT_SECONDS;
-
-        while (state.running && state.passengers_boarded < CAR_CAPACITY) {
-            int res = pthread_cond_timedwait(&state.car_ready_to_run, &state.mutex, &timeout);
-            if (res == ETIMEDOUT) {
-                print_time();
-                printf("[Car %d] Timed out with %d/%d passengers\n", 
-                       id, state.passengers_boarded, CAR_CAPACITY);
+        //the -D policy sets the deadline again every time someone boards, the wheel timer follows it
+        prof_lock(&car->mutex);
+        int64_t armed = 0;
+        while (car->running && car->passengers_boarded < CAR_CAPACITY) {
+            int64_t now = timer_now();
+            int64_t deadline = dispatch_deadline(&dispatch, car->passengers_boarded, timespec_ns(&load_start),
+                                                 car->first_ticket, &state.line_rate, now);
+            if (deadline <= now) {
+                if (now - timespec_ns(&load_start) >= dispatch.max_wait) {
+                    log_event(LOG_CAR_TIMEOUT, id, car->passengers_boarded, CAR_CAPACITY, 0);
+                }
                 break;
             }
+            if (deadline != armed) {
+                timer_cancel(&car->load_timer);
+                timer_add(&car->load_timer, deadline);
+                armed = deadline;
+            }
+            prof_wait(&car->car_ready_to_run, &car->mutex);
         }
-
-        state.loading = 0;
-        pthread_mutex_unlock(&state.mutex);
-
-        pthread_mutex_lock(&state.mutex);
+        timer_cancel(&car->load_timer);
+        prof_unlock(&car->mutex);
+
+        //leave the platform, nobody can claim a seat after this
+        prof_lock(&state.mutex);
+        int claimed = CAR_CAPACITY - state.platforms[platform].seats;
+        state.platforms[platform].car = NULL;
+        state.free_platforms++;
+        pthread_cond_signal(&state.platform_free);
         int running = state.running;
-        pthread_mutex_unlock(&state.mutex);
+        prof_unlock(&state.mutex);
+
+        //passengers that claimed a seat may still be on their way in
+        prof_lock(&car->mutex);
+        while (car->running && car->passengers_boarded < claimed) {
+            prof_wait(&car->car_ready_to_run, &car->mutex);
+        }
+        car->loading = 0;
+        int boarded = car->passengers_boarded;
+        prof_unlock(&car->mutex);
         if (!running){
             break;
         }
 
-        print_time();
-        printf("[Car %d] Running ride...\n", id);
-        pthread_mutex_lock(&ticket_mutex);
-        total_rides_completed++;
-        total_passengers_served += state.passengers_boarded;
-        pthread_mutex_unlock(&ticket_mutex);
-        sleep(RIDE_SECONDS);
-
-        pthread_mutex_lock(&state.mutex);
-        state.unloading = 1;
-        pthread_cond_broadcast(&state.car_unloading);
-        while (state.running && state.passengers_unboarded < state.passengers_boarded) {
-            pthread_cond_wait(&state.car_unloading, &state.mutex);
-        }
-        state.unloading = 0;
-        if (!state.running) {
-            pthread_mutex_unlock(&state.mutex);
+        clock_gettime(CLOCK_MONOTONIC, &load_end);
+        stats_latency(&stats, LAT_CAR_LOAD, elapsed_ns(&load_start, &load_end));
+        log_event(LOG_CAR_RUNNING, id, 0, 0, 0);
+        stats_ride(&stats, boarded, CAR_CAPACITY);
+        park_sleep(RIDE_SECONDS);
+
+        prof_lock(&car->mutex);
+        car->unloading = 1;
+        pthread_cond_broadcast(&car->car_unloading);
+        while (car->running && car->passengers_unboarded < car->passengers_boarded) {
+            prof_wait(&car->car_unloading, &car->mutex);
+        }
+        car->unloading = 0;
+        if (!car->running) {
+            prof_unlock(&car->mutex);
             break;
         }
-        print_time();
-        printf("[Car %d] Unloading complete\n", id);
-        pthread_mutex_unlock(&state.mutex);
+        log_event(LOG_CAR_UNLOADED, id, 0, 0, 0);
+        prof_unlock(&car->mutex);
     }
-    print_time();
-    printf("Car %d exiting\n", id);
+    log_event(LOG_CAR_EXITING, id, 0, 0, 0);
+    placement_thread_done(THREADS_CARS);
     return NULL;
 }
 
-int main(int argc, char* argv[]) {
-    srand(time(NULL));
-    clock_gettime(CLOCK_REALTIME, &start_time);
+#define SPAWN_BATCH 1024 // threads one spawner starts at least
+#define MAX_SPAWNERS 16
 
+//threads first..first+count-1 of a table, thread i gets id i + 1
+typedef struct {
+    pthread_t* tids;
+    int first;
+    int count;
+    void* (*run)(void*);
+    const pthread_attr_t* attr;
+} SpawnRange;
+
+static void spawn_range(const SpawnRange* r) {
+    for (int i = r->first; i < r->first + r->count; ++i) {
+        int err = pthread_create(&r->tids[i], r->attr, r->run, (void*)(intptr_t)(i + 1));
+        if (err) {
+            fprintf(stderr, "cannot start thread %d of %d: %s\n", i + 1, r->first + r->count, strerror(err));
+            exit(1);
+        }
+    }
+}
+
+static void* spawner_thread(void* arg) {
+    spawn_range(arg);
+    return NULL;
+}
+
+//pthread_create mostly waits on the kernel mapping a stack, so a big fleet is started from one spawner per cpu
+static void spawn_threads(pthread_t* tids, int count, void* (*run)(void*), const pthread_attr_t* attr) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int spawners = count / SPAWN_BATCH;
+    spawners = spawners < cpus ? spawners : cpus;
+    spawners = spawners < MAX_SPAWNERS ? spawners : MAX_SPAWNERS;
+    if (spawners <= 1) {
+        SpawnRange all = { tids, 0, count, run, attr };
+        spawn_range(&all);
+        return;
+    }
+    SpawnRange ranges[MAX_SPAWNERS];
+    pthread_t spawner_tids[MAX_SPAWNERS];
+    int started[MAX_SPAWNERS];
+    for (int k = 0; k < spawners; ++k) {
+        int first = (int)((int64_t)count * k / spawners);
+        ranges[k] = (SpawnRange){ tids, first, (int)((int64_t)count * (k + 1) / spawners) - first, run, attr };
+        started[k] = pthread_create(&spawner_tids[k], attr, spawner_thread, &ranges[k]) == 0;
+    }
+    //a spawner that could not start leaves its batch to this thread, the threads themselves still have to start
+    for (int k = 0; k < spawners; ++k) {
+        if (!started[k]) {
+            spawn_range(&ranges[k]);
+        }
+    }
+    for (int k = 0; k < spawners; ++k) {
+        if (started[k]) {
+            pthread_join(spawner_tids[k], NULL);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SEED = time(NULL);
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &start_time);
+
+    static const struct option long_options[] = {
+        { "seed", required_argument, NULL, 's' },
+        { "sweep", no_argument, NULL, 'S' },
+        { "reps", required_argument, NULL, 'R' },
+        { "trace", required_argument, NULL, 'T' },
+        { "export", required_argument, NULL, 'X' },
+        { "export-interval", required_argument, NULL, 'I' },
+        { "arrivals", required_argument, NULL, 'a' },
+        { "rides", required_argument, NULL, 'i' },
+        { "threshold", required_argument, NULL, 'h' },
+        { "target", required_argument, NULL, 'g' },
+        { "optimize", no_argument, NULL, 'O' },
+        { "sla", required_argument, NULL, 'Q' },
+        { "checkpoint", required_argument, NULL, 'K' },
+        { "checkpoint-interval", required_argument, NULL, 'k' },
+        { "restore", required_argument, NULL, 'e' },
+        { "shards", required_argument, NULL, 'N' },
+        { "stack-size", required_argument, NULL, 'Z' },
+        { "fastpass", required_argument, NULL, 'F' },
+        { "fastpass-ratio", required_argument, NULL, 'f' },
+        { "cpus-cars", required_argument, NULL, 'Y' },
+        { "cpus-passengers", required_argument, NULL, 'U' },
+        { "cpus-monitor", required_argument, NULL, 'M' },
+        { "thread-stats", no_argument, NULL, 'W' },
+        { NULL, 0, NULL, 0 }
+    };
+    const char* specs[128] = { NULL }; // raw option values, a sweep reads them as lists
     int opt;
-    while ((opt = getopt(argc, argv, "n:c:p:w:r:")) != -1) {
+    while ((opt = getopt_long(argc, argv, "n:c:p:w:r:l:b:d:vmt:L:s:SR:A:P:T:D:", long_options, NULL)) != -1) {
+        if (optarg && opt < 128) {
+            specs[opt] = optarg;
+        }
         switch (opt) {
             case 'n': NUM_PASSENGERS = atoi(optarg); break;
             case 'c': NUM_CARS = atoi(optarg); break;
             case 'p': CAR_CAPACITY = atoi(optarg); break;
             case 'w': WAIT_SECONDS = atoi(optarg); break;
             case 'r': RIDE_SECONDS = atoi(optarg); break;
+            case 'l': NUM_PLATFORMS = atoi(optarg); break;
+            case 'b': NUM_BOOTHS = atoi(optarg); break;
+            case 'd': SIM_SECONDS = atoi(optarg); break;
+            case 'v': VIRTUAL_TIME = 1; break;
+            case 'm': WORKER_POOL = 1; break;
+            case 't': NUM_WORKERS = atoi(optarg); break;
+            case 'L': LOG_LEVEL = atoi(optarg); break;
+            case 's': SEED = strtoull(optarg, NULL, 10); break;
+            case 'S': SWEEP = 1; break;
+            case 'R': REPLICATIONS = atoi(optarg); break;
+            case 'O': OPTIMIZE = 1; break;
+            case 'Q': SLA_SECONDS = atof(optarg); break;
+            case 'T': TRACE_PATH = optarg; break;
+            case 'X': EXPORT_NAME = optarg; break;
+            case 'I': EXPORT_INTERVAL_MS = atoi(optarg); break;
+            case 'K': CHECKPOINT_PATH = optarg; break;
+            case 'k': CHECKPOINT_INTERVAL = atoi(optarg); break;
+            case 'e': RESTORE_PATH = optarg; break;
+            case 'N': SHARDS = atoi(optarg); break;
+            case 'Z': STACK_KB = atoi(optarg); break;
+            case 'Y':
+            case 'U':
+            case 'M':
+                if (placement_parse(opt == 'Y' ? THREADS_CARS : opt == 'U' ? THREADS_PASSENGERS : THREADS_MONITOR,
+                                    optarg)) {
+                    exit(1);
+                }
+                break;
+            case 'W': THREAD_STATS = 1; break;
+            case 'F': FASTPASS_PERCENT = atoi(optarg); break;
+            case 'f':
+                if (sscanf(optarg, "%d:%d", &FASTPASS_SEATS, &STANDBY_SEATS) != 2 || FASTPASS_SEATS < 0 ||
+                    STANDBY_SEATS < 0 || FASTPASS_SEATS + STANDBY_SEATS == 0) {
+                    fprintf(stderr, "--fastpass-ratio takes fast-pass:standby seats, like 3:2\n");
+                    exit(1);
+                }
+                break;
+            case 'a':
+                NUM_ARRIVALS = parse_arrivals(optarg, &ARRIVALS);
+                if (NUM_ARRIVALS < 0) {
+                    exit(1);
+                }
+                break;
+            case 'i': RIDES_PER_VISIT = atoi(optarg); break;
+            case 'D':
+                DISPATCH_POLICY = parse_dispatch(optarg);
+                if (DISPATCH_POLICY < 0) {
+                    fprintf(stderr, "-D takes timeout, queue, sla or adaptive\n");
+                    exit(1);
+                }
+                break;
+            case 'h': DISPATCH_THRESHOLD = atoi(optarg); break;
+            case 'g': TARGET_SECONDS = atoi(optarg); break;
+            case 'A':
+                NUM_ATTRACTIONS = load_attractions(optarg, &ATTRACTIONS);
+                if (NUM_ATTRACTIONS < 0) {
+                    exit(1);
+                }
+                break;
+            case 'P':
+                PICK_POLICY = parse_policy(optarg);
+                if (PICK_POLICY < 0) {
+                    fprintf(stderr, "-P takes random, shortest or weighted\n");
+                    exit(1);
+                }
+                break;
             default:
-                fprintf(stderr, "Usage: %s -n num_passengers -c num_cars -p capacity -w wait -r ride\n", argv[0]);
+                fprintf(stderr, "Usage: %s -n num_passengers -c num_cars -p capacity -w wait -r ride [-l platforms] [-b booths] [-d seconds] [-v | -m [-t workers]] [-L 0-2] [-A attractions [-P random|shortest|weighted]] [-D timeout|queue|sla|adaptive [--threshold riders] [--target seconds]] [--seed n] [--sweep [--reps n] | --optimize [--sla seconds]] [--trace file] [--export name [--export-interval ms]] [--arrivals day|hour:rate,... [--rides n]] [--checkpoint file [--checkpoint-interval seconds]] [--restore file] [--shards n] [--stack-size KB] [--fastpass percent [--fastpass-ratio n:m]] [--cpus-cars|--cpus-passengers|--cpus-monitor list] [--thread-stats]\n", argv[0]);
                 exit(1);
         }
     }
 
+    if (NUM_PLATFORMS < 1) {
+        NUM_PLATFORMS = 1;
+    }
+    if (NUM_BOOTHS < 1) {
+        NUM_BOOTHS = 1;
+    }
+    if (FASTPASS_PERCENT > 0 && (VIRTUAL_TIME || WORKER_POOL || SWEEP || OPTIMIZE || SHARDS > 1)) {
+        fprintf(stderr, "--fastpass runs in the threaded version only, the event driven ones have no lanes\n");
+        exit(1);
+    }
+    ParkConfig cfg = park_config();
+    if (SHARDS > 1) {
+        if (WORKER_POOL || SWEEP || OPTIMIZE || TRACE_PATH || EXPORT_NAME || CHECKPOINT_PATH || RESTORE_PATH) {
+            fprintf(stderr, "--shards runs one virtual time park, not with -m, --sweep, --optimize, --trace, --export or checkpoints\n");
+            exit(1);
+        }
+        return run_shards(&cfg, SHARDS);
+    }
+    if ((CHECKPOINT_PATH || RESTORE_PATH) && (!VIRTUAL_TIME || SWEEP || OPTIMIZE)) {
+        fprintf(stderr, "--checkpoint and --restore need -v, only the virtual time park keeps its whole state in one place\n");
+        exit(1);
+    }
+    if (RESTORE_PATH && !specs['d']) {
+        cfg.sim_seconds = 0; // the closing time saved with the checkpoint
+    }
+    if (SWEEP || OPTIMIZE) {
+        if (TRACE_PATH || EXPORT_NAME) {
+            fprintf(stderr, "--trace and --export follow one park, not a sweep\n");
+            exit(1);
+        }
+        return OPTIMIZE ? run_optimize(&cfg, specs, SLA_SECONDS) : run_sweep(&cfg, specs, REPLICATIONS);
+    }
+    if (TRACE_PATH) {
+        if (log_trace_open(TRACE_PATH, SEED)) {
+            exit(1);
+        }
+        log_clock = CLOCK_MONOTONIC;
+        clock_gettime(log_clock, &start_time);
+    }
+    log_init(LOG_LEVEL);
+    if (VIRTUAL_TIME) {
+        return run_virtual(&cfg);
+    }
+    if (WORKER_POOL) {
+        return run_pool(&cfg);
+    }
+    if (NUM_ATTRACTIONS > 0) {
+        fprintf(stderr, "-A needs -v or -m, the threaded version has a single ride\n");
+        exit(1);
+    }
+    if (ARRIVALS) {
+        fprintf(stderr, "--arrivals needs -v or -m, the threaded version has a fixed set of passengers\n");
+        exit(1);
+    }
+    if (CAR_CAPACITY < 1 || CAR_CAPACITY > MAX_CAPACITY) {
+        fprintf(stderr, "car capacity must be between 1 and %d\n", MAX_CAPACITY);
+        exit(1);
+    }
+    for (int c = 0; c < NUM_GUEST_CLASSES; ++c) {
+        hist_init(&class_waits[c]);
+    }
+
+    stats_init(&stats);
+    guests_init(&guest_table);
+    for (int i = 0; i < NUM_PASSENGERS; ++i) {
+        guests_admit(&guest_table, i);
+    }
+    dispatch_init(&dispatch, &cfg, CAR_CAPACITY, WAIT_SECONDS);
     state.running = 1;
-    state.car_capacity = CAR_CAPACITY;
+    state.free_platforms = NUM_PLATFORMS;
+    //cars claim platforms and take their own lock far more often than anyone else touches either
+    size_t platforms_size = NUM_PLATFORMS * sizeof(Platform);
+    size_t cars_size = (NUM_CARS > 0 ? NUM_CARS : 1) * sizeof(CarState);
+    state.platforms = placement_alloc(THREADS_CARS, platforms_size);
+    cars = placement_alloc(THREADS_CARS, cars_size);
+    office.open = 1;
+    office.free_booths = NUM_BOOTHS;
+    office.busy = calloc(NUM_BOOTHS, sizeof(int));
+    office.stats = calloc(NUM_BOOTHS, sizeof(BoothStats));
+    if (!state.platforms || !cars || !office.busy || !office.stats) {
+        perror("calloc");
+        exit(1);
+    }
     pthread_mutex_init(&state.mutex, NULL);
-    pthread_cond_init(&state.car_loading, NULL);
-    pthread_cond_init(&state.car_unloading, NULL);
-    pthread_cond_init(&state.car_ready_to_run, NULL);
+    pthread_cond_init(&state.platform_free, NULL);
+    pthread_mutex_init(&office.mutex, NULL);
+    pthread_cond_init(&office.booth_free, NULL);
+    prof_name(&state.mutex, "state.mutex");
+    prof_name(&office.mutex, "office.mutex");
+    for (int i = 0; i < NUM_CARS; ++i) {
+        cars[i].id = i + 1;
+        cars[i].running = 1;
+        pthread_mutex_init(&cars[i].mutex, NULL);
+        prof_name(&cars[i].mutex, "car.mutex");
+        pthread_cond_init(&cars[i].car_unloading, NULL);
+        pthread_cond_init(&cars[i].car_ready_to_run, NULL);
+        timer_init(&cars[i].load_timer, car_timeout);
+    }
 
-    pthread_t passenger_threads[NUM_PASSENGERS];
-    pthread_t car_threads[NUM_CARS];
+    pthread_t* passenger_threads = calloc(NUM_PASSENGERS > 0 ? NUM_PASSENGERS : 1, sizeof(pthread_t));
+    pthread_t* car_threads = calloc(NUM_CARS > 0 ? NUM_CARS : 1, sizeof(pthread_t));
     pthread_t monitor_tid;
+    if (!passenger_threads || !car_threads) {
+        perror("calloc");
+        exit(1);
+    }
+    size_t stack = (size_t)STACK_KB * 1024;
+    long stack_min = sysconf(_SC_THREAD_STACK_MIN);
+    if (stack_min > 0 && stack < (size_t)stack_min) {
+        stack = stack_min;
+    }
+    pthread_attr_t car_attr, passenger_attr, monitor_attr;
+    pthread_attr_init(&car_attr);
+    pthread_attr_init(&passenger_attr);
+    pthread_attr_init(&monitor_attr);
+    if (pthread_attr_setstacksize(&car_attr, stack) || pthread_attr_setstacksize(&passenger_attr, stack)) {
+        fprintf(stderr, "--stack-size %d KB is not a valid stack size\n", STACK_KB);
+        exit(1);
+    }
+    placement_attr(THREADS_CARS, &car_attr);
+    placement_attr(THREADS_PASSENGERS, &passenger_attr);
+    placement_attr(THREADS_MONITOR, &monitor_attr);
 
-    // monitor thread
-    pthread_create(&monitor_tid, NULL, monitor_thread, NULL);
+    timer_wheel_start();
 
-    for (int i = 0; i < NUM_CARS; ++i) {
-        int* id = malloc(sizeof(int));
-        *id = i + 1;
-        pthread_create(&car_threads[i], NULL, car_thread, id);
+    // monitor thread
+    pthread_create(&monitor_tid, &monitor_attr, monitor_thread, NULL);
+    pthread_attr_destroy(&monitor_attr);
+    if (EXPORT_NAME) {
+        export_start(EXPORT_NAME, EXPORT_INTERVAL_MS, &stats, &cfg, NULL, NULL);
     }
 
-    for (int i = 0; i < NUM_PASSENGERS; ++i) {
-        int* id = malloc(sizeof(int));
-        *id = i + 1;
-        pthread_create(&passenger_threads[i], NULL, passenger_thread, id);
-    }
+    struct timespec spawn_start, spawn_end;
+    clock_gettime(CLOCK_MONOTONIC, &spawn_start);
+    spawn_threads(car_threads, NUM_CARS, car_thread, &car_attr);
+    spawn_threads(passenger_threads, NUM_PASSENGERS, passenger_thread, &passenger_attr);
+    clock_gettime(CLOCK_MONOTONIC, &spawn_end);
+    pthread_attr_destroy(&car_attr);
+    pthread_attr_destroy(&passenger_attr);
+
+    sleep(SIM_SECONDS);
 
-    sleep(10);
+    struct timespec close_start, close_end;
+    clock_gettime(CLOCK_MONOTONIC, &close_start);
 
-    pthread_mutex_lock(&state.mutex);
+    prof_lock(&state.mutex);
     state.running = 0;
-    pthread_cond_broadcast(&state.car_loading);
-    pthread_cond_broadcast(&state.car_unloading);
-    pthread_cond_broadcast(&state.car_ready_to_run);
-    pthread_mutex_unlock(&state.mutex);
+    Waiter* w;
+    while ((w = line_pop(0))) {
+        w->car = NULL;
+        sem_post(&w->ready);
+    }
+    pthread_cond_broadcast(&state.platform_free);
+    prof_unlock(&state.mutex);
+    prof_lock(&office.mutex);
+    office.open = 0;
+    pthread_cond_broadcast(&office.booth_free);
+    prof_unlock(&office.mutex);
+    for (int i = 0; i < NUM_CARS; ++i) {
+        prof_lock(&cars[i].mutex);
+        cars[i].running = 0;
+        pthread_cond_broadcast(&cars[i].car_unloading);
+        pthread_cond_broadcast(&cars[i].car_ready_to_run);
+        prof_unlock(&cars[i].mutex);
+    }
+    timer_wheel_close();
 
     for (int i = 0; i < NUM_PASSENGERS; ++i) {
         pthread_join(passenger_threads[i], NULL);
@@ -307,32 +940,51 @@ int main(int argc, char* argv[]) {
         pthread_join(car_threads[i], NULL);
     }
     pthread_join(monitor_tid, NULL);
+    timer_wheel_stop();
+    clock_gettime(CLOCK_MONOTONIC, &close_end);
+    free(passenger_threads);
+    free(car_threads);
 
     pthread_mutex_destroy(&state.mutex);
-    pthread_cond_destroy(&state.car_loading);
-    pthread_cond_destroy(&state.car_unloading);
-    pthread_cond_destroy(&state.car_ready_to_run);
-
-    print_time();
-    printf("Simulation ended\n");
+    pthread_cond_destroy(&state.platform_free);
+    pthread_mutex_destroy(&office.mutex);
+    pthread_cond_destroy(&office.booth_free);
+    for (int i = 0; i < NUM_CARS; ++i) {
+        pthread_mutex_destroy(&cars[i].mutex);
+        pthread_cond_destroy(&cars[i].car_unloading);
+        pthread_cond_destroy(&cars[i].car_ready_to_run);
+    }
+    placement_free(THREADS_CARS, cars, cars_size);
+    placement_free(THREADS_CARS, state.platforms, platforms_size);
+    free(office.busy);
+    guests_free(&guest_table);
+
+    log_event(LOG_SIM_ENDED, 0, 0, 0, 0);
+    log_shutdown();
+    export_stop();
     struct timespec sim_end;
-    clock_gettime(CLOCK_REALTIME, &sim_end);
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &sim_end);
     int duration = sim_end.tv_sec - start_time.tv_sec;
-    int hh = duration / 3600, mm = (duration % 3600) / 60, ss = duration % 60;
 
     //final monitor statistics
-    printf("\n[Monitor] FINAL STATISTICS:\n");
-    printf("Total simulation time: %02d:%02d:%02d\n", hh, mm, ss);
-    printf("Total passengers: %d\n", total_passengers_served);
-    printf("Total rides completed: %d\n", total_rides_completed);
-    printf("Average wait time in ticket queue: %.1f ms\n",
-        total_ticket_requests ? total_ticket_wait / total_ticket_requests : 0);
-    printf("Average wait time in ride queue: %.1f ms\n",
-        total_ride_requests ? total_ride_wait / total_ride_requests : 0);
-    printf("Average car utilization: %.0f%% (%.1f/%d passengers per ride)\n",
-        total_rides_completed ? (100.0 * total_passengers_served) / (total_rides_completed * CAR_CAPACITY) : 0,
-        total_rides_completed ? (1.0 * total_passengers_served) / total_rides_completed : 0,
-        CAR_CAPACITY);
+    ParkStats s;
+    stats_read(&stats, &s);
+    print_final_stats(&s, &cfg, duration);
+    print_booth_stats(office.stats, NUM_BOOTHS, duration);
+    if (FASTPASS_PERCENT > 0) {
+        printf("Fast-pass: %d%% of passengers, %d:%d fast-pass:standby seats\n", FASTPASS_PERCENT, FASTPASS_SEATS,
+               STANDBY_SEATS);
+        print_class_waits(0);
+    }
+    print_startup_stats(NUM_CARS + NUM_PASSENGERS, (int)(stack / 1024), elapsed_ns(&spawn_start, &spawn_end) / 1e6,
+                        elapsed_ns(&close_start, &close_end) / 1e6);
+    placement_report();
+    free(office.stats);
+#ifdef BENCH
+    bench_report("part3", NUM_PASSENGERS, NUM_CARS, s.rides_completed, s.passengers_served,
+                 s.ticket_requests, elapsed_ns(&start_time, &sim_end) / 1e9);
+#endif
+    prof_report();
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,159 @@
+#ifndef PARK_H
+#define PARK_H
+
+#include <stdint.h>
+
+//shared between the threaded version (park.c), the virtual time version (sim.c) and the worker pool version (pool.c)
+
+#define MAX_CAPACITY 100
+#define MONITOR_INTERVAL 5 // Print stats every 5 seconds
+#define NS_PER_SEC 1000000000LL
+
+//settings
+extern int NUM_PASSENGERS;
+extern int NUM_CARS;
+extern int CAR_CAPACITY;
+extern int WAIT_SECONDS;
+extern int RIDE_SECONDS;
+extern int NUM_PLATFORMS; // cars that can load at the same time
+extern int NUM_BOOTHS; // ticket booths selling at the same time
+extern int SIM_SECONDS; // how long the park stays open
+extern int NUM_WORKERS; // worker pool size, 0 means one per core
+extern const char* EXPORT_NAME; // shared memory name for live statistics, NULL for none
+extern int EXPORT_INTERVAL_MS;
+extern const char* CHECKPOINT_PATH; // -v only, NULL for none
+extern int CHECKPOINT_INTERVAL;     // seconds of park time
+extern const char* RESTORE_PATH;    // checkpoint to carry on from, NULL to start the day fresh
+extern uint64_t SEED; // passenger i draws from rng stream (SEED, i)
+
+typedef enum {
+    LAT_TICKET_WAIT,
+    LAT_RIDE_WAIT,
+    LAT_CAR_LOAD, // at the platform, from loading to departure
+    LAT_CAR_IDLE, // after unloading, waiting for a free platform
+    NUM_LATENCIES
+} LatencyMetric;
+
+typedef struct {
+    double p50, p90, p99, p999, max; // ms
+} LatencySummary;
+
+//one ride of a multi-attraction park, read from the -A file
+typedef struct {
+    char name[32];
+    int cars;
+    int capacity;
+    int wait_seconds;
+    int ride_seconds;
+    int platforms;
+    int popularity; // weight for the weighted pick policy
+} AttractionConfig;
+
+//how a passenger picks the next attraction after exploring (-P)
+typedef enum { PICK_RANDOM, PICK_SHORTEST, PICK_WEIGHTED } PickPolicy;
+
+//when a car that is not full leaves the platform (-D), see dispatch.h
+typedef enum { DISPATCH_TIMEOUT, DISPATCH_QUEUE, DISPATCH_SLA, DISPATCH_ADAPTIVE, NUM_DISPATCH } DispatchPolicy;
+
+//open arrivals (--arrivals): from hour of the day start on, guests arrive at rate per hour, the schedule repeats every day
+typedef struct {
+    double start; // hours since midnight
+    double rate;  // guests per hour
+} ArrivalPoint;
+
+//settings of one park, sim.c keeps its own copy so several parks can run side by side
+typedef struct {
+    int passengers;
+    int cars;
+    int capacity;
+    int wait_seconds;
+    int ride_seconds;
+    int platforms;
+    int booths;
+    int sim_seconds;
+    uint64_t seed;
+    const AttractionConfig* attractions; // NULL for a single ride built from the settings above
+    int num_attractions;
+    int policy;
+    const ArrivalPoint* arrivals; // NULL for a closed park of passengers that never leave
+    int num_arrivals;
+    int rides_per_visit; // mean rides before an arriving guest leaves
+    int dispatch;
+    int threshold;      // riders for the queue dispatch policy, 0 for half the car
+    int target_seconds; // wait since the ticket for the sla dispatch policy
+} ParkConfig;
+
+ParkConfig park_config(void); // from the command line settings above
+
+//attractions.c, returns the number of attractions read or -1
+int load_attractions(const char* path, AttractionConfig** out);
+int parse_policy(const char* name); // -1 if unknown
+int parse_arrivals(const char* spec, ArrivalPoint** out); // returns the number of points or -1
+
+//dispatch.c
+int parse_dispatch(const char* name); // -1 if unknown
+const char* dispatch_name(int policy);
+
+//monitor statistics, same for both versions
+typedef struct {
+    int passengers_served;
+    int rides_completed;
+    int seats_offered; // capacity of every car that left, attractions can differ
+    double ticket_wait; // ms
+    double ride_wait;   // ms
+    int ticket_requests;
+    int ride_requests;
+    LatencySummary latency[NUM_LATENCIES];
+} ParkStats;
+
+//where a guest is now, kept per guest in the guest table (guests.h)
+//a free row has no guest, its guest left or walked to another shard (--shards) with its figures
+typedef enum { GUEST_EXPLORING, GUEST_TICKET, GUEST_QUEUED, GUEST_RIDING, GUEST_LEFT, GUEST_FREE, NUM_GUEST_PHASES } GuestPhase;
+
+//which lane a passenger of the threaded park waits for a seat in (--fastpass)
+typedef enum { GUEST_STANDBY, GUEST_FASTPASS, NUM_GUEST_CLASSES } GuestClass;
+
+//per guest figures over every guest so far, from a scan of the guest table
+typedef struct {
+    int guests;
+    int phases[NUM_GUEST_PHASES]; // guests in each phase now
+    double rides_avg;
+    int rides_p50, rides_p90, rides_max;
+    double rides_fairness; // Jain's index, 1 when every guest rode as often, 1/guests when one guest took every ride
+    double wait_avg, wait_p50, wait_p90, wait_max; // s spent in the ticket and ride lines
+    double wait_fairness;
+} GuestSummary;
+
+//per booth, guarded by the ticket office lock
+typedef struct {
+    int tickets_sold;
+    double service_time; // ms spent selling
+} BoothStats;
+
+//timestamp printer, shows simulated time when a virtual clock is set
+void print_time(void);
+void set_virtual_clock(const int64_t* now_ns);
+int64_t park_clock(void); // ns since the park opened, simulated when a virtual clock is set
+
+void print_monitor_stats(const ParkStats* s, const GuestSummary* g);
+//report.c
+void print_latency(int metric, const LatencySummary* l);
+void print_final_stats(const ParkStats* s, const ParkConfig* cfg, int duration);
+void print_booth_stats(const BoothStats* booths, int num_booths, int duration);
+void print_attraction_stats_line(const AttractionConfig* cfg, int rides, int riders, double ride_wait, int waiting);
+void print_startup_stats(int threads, int stack_kb, double start_ms, double shutdown_ms);
+
+//virtual time version (sim.c)
+int run_virtual(const ParkConfig* cfg);
+
+//worker pool version (pool.c)
+int run_pool(const ParkConfig* cfg);
+
+//parameter sweep (sweep.c), specs are the -n/-c/-p/-w/-r/-l/-b arguments as lists or ranges
+int run_sweep(const ParkConfig* base, const char* specs[], int replications);
+//shard.c, the -A attractions split over forked processes that pass walking guests through shared memory
+int run_shards(const ParkConfig* cfg, int shards);
+//optimize.c, cheapest -c/-p/-w fleets with a p95 ride wait under sla seconds, Pareto set as CSV
+int run_optimize(const ParkConfig* base, const char* specs[], double sla);
+
+#endif
@@ -0,0 +1,204 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include "placement.h"
+
+int THREAD_STATS = 0;
+
+static const char* kind_names[NUM_THREAD_KINDS] = {
+    [THREADS_CARS] = "Car", [THREADS_PASSENGERS] = "Passenger", [THREADS_MONITOR] = "Monitor",
+};
+
+static cpu_set_t cpus[NUM_THREAD_KINDS];
+static int pinned[NUM_THREAD_KINDS];
+
+//summed as threads exit, one lock is fine off the hot path
+typedef struct {
+    int threads;
+    long voluntary;
+    long involuntary;
+    long migrations; // -1 when the kernel does not show them
+    long max_migrations;
+    cpu_set_t last_cpus; // where the threads were when they finished
+} KindUsage;
+
+static KindUsage usage[NUM_THREAD_KINDS];
+static pthread_mutex_t usage_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+int placement_parse(int kind, const char* spec) {
+    CPU_ZERO(&cpus[kind]);
+    const char* p = spec;
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p || first < 0) {
+            break;
+        }
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first) {
+                break;
+            }
+            p = end;
+        }
+        if (last >= CPU_SETSIZE) {
+            break;
+        }
+        for (long c = first; c <= last; ++c) {
+            CPU_SET(c, &cpus[kind]);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            break;
+        }
+    }
+    if (*p || CPU_COUNT(&cpus[kind]) == 0) {
+        fprintf(stderr, "not a cpu list: %s, give cpus like 0-3,8\n", spec);
+        return -1;
+    }
+    cpu_set_t allowed, missing;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        CPU_AND(&missing, &cpus[kind], &allowed);
+        CPU_XOR(&missing, &missing, &cpus[kind]);
+        if (CPU_COUNT(&missing) > 0) {
+            fprintf(stderr, "cpus in %s are not available to the park\n", spec);
+            return -1;
+        }
+    }
+    pinned[kind] = 1;
+    return 0;
+}
+
+void placement_attr(int kind, pthread_attr_t* attr) {
+    if (pinned[kind]) {
+        pthread_attr_setaffinity_np(attr, sizeof(cpu_set_t), &cpus[kind]);
+    }
+}
+
+//mmap pages are only backed when first written, by the node of the cpu that writes them
+//a heap block may share pages already touched elsewhere, so pinned kinds get pages of their own
+void* placement_alloc(int kind, size_t size) {
+    if (!pinned[kind]) {
+        return calloc(1, size ? size : 1);
+    }
+    void* p = mmap(NULL, size ? size : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    cpu_set_t own;
+    pthread_getaffinity_np(pthread_self(), sizeof(own), &own);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus[kind]) == 0) {
+        memset(p, 0, size);
+        pthread_setaffinity_np(pthread_self(), sizeof(own), &own);
+    }
+    return p;
+}
+
+void placement_free(int kind, void* p, size_t size) {
+    if (!pinned[kind]) {
+        free(p);
+    } else if (p) {
+        munmap(p, size ? size : 1);
+    }
+}
+
+//se.nr_migrations of the calling thread, -1 if the kernel was built without scheduler statistics
+static long migrations(void) {
+    FILE* f = fopen("/proc/thread-self/sched", "r");
+    if (!f) {
+        return -1;
+    }
+    char line[256];
+    long n = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, "se.nr_migrations", 16) == 0) {
+            char* colon = strchr(line, ':');
+            n = colon ? strtol(colon + 1, NULL, 10) : -1;
+            break;
+        }
+    }
+    fclose(f);
+    return n;
+}
+
+void placement_thread_done(int kind) {
+    if (!THREAD_STATS) {
+        return;
+    }
+    struct rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    long moved = migrations();
+    int cpu = sched_getcpu();
+
+    pthread_mutex_lock(&usage_mutex);
+    KindUsage* u = &usage[kind];
+    if (u->threads == 0) {
+        CPU_ZERO(&u->last_cpus);
+    }
+    u->voluntary += ru.ru_nvcsw;
+    u->involuntary += ru.ru_nivcsw;
+    if (moved < 0 || (u->threads > 0 && u->migrations < 0)) {
+        u->migrations = -1;
+    } else {
+        u->migrations += moved;
+        u->max_migrations = moved > u->max_migrations ? moved : u->max_migrations;
+    }
+    if (cpu >= 0 && cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, &u->last_cpus);
+    }
+    u->threads++;
+    pthread_mutex_unlock(&usage_mutex);
+}
+
+//0-3,8 style
+static void print_cpus(const cpu_set_t* set) {
+    const char* sep = "";
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+        if (!CPU_ISSET(c, set)) {
+            continue;
+        }
+        int last = c;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, set)) {
+            last++;
+        }
+        printf(last > c ? "%s%d-%d" : "%s%d", sep, c, last);
+        sep = ",";
+        c = last;
+    }
+}
+
+void placement_report(void) {
+    if (!THREAD_STATS) {
+        return;
+    }
+    pthread_mutex_lock(&usage_mutex);
+    for (int k = 0; k < NUM_THREAD_KINDS; ++k) {
+        const KindUsage* u = &usage[k];
+        if (u->threads == 0) {
+            continue;
+        }
+        printf("%s threads: %d, context switches voluntary/involuntary %ld/%ld, ", kind_names[k], u->threads,
+               u->voluntary, u->involuntary);
+        if (u->migrations < 0) {
+            printf("migrations not shown by this kernel");
+        } else {
+            printf("migrations %ld (max %ld per thread)", u->migrations, u->max_migrations);
+        }
+        printf(", finished on cpus ");
+        print_cpus(&u->last_cpus);
+        if (pinned[k]) {
+            printf(" of ");
+            print_cpus(&cpus[k]);
+        }
+        printf("\n");
+    }
+    pthread_mutex_unlock(&usage_mutex);
+}
@@ -0,0 +1,30 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+#include <pthread.h>
+
+//cpu placement of the threads of the threaded and the worker pool parks
+//--cpus-cars, --cpus-passengers and --cpus-monitor take cpu lists like 0-3,8 and pin each kind of thread to its list,
+//the -m workers count as passengers
+//data used mostly by one kind is first touched from that kind's cpus, so the kernel puts its pages on their NUMA node:
+//the car and platform tables of the threaded park, the attractions and cars of the -m park
+//--thread-stats sums context switches and migrations per kind as the threads exit and prints them with the final report
+
+typedef enum { THREADS_CARS, THREADS_PASSENGERS, THREADS_MONITOR, NUM_THREAD_KINDS } ThreadKind;
+
+extern int THREAD_STATS;
+
+//returns 0, or -1 with a message if the list is not valid
+int placement_parse(int kind, const char* spec);
+//threads created with attr run on the kind's cpus, attr is left alone when the kind has no list
+void placement_attr(int kind, pthread_attr_t* attr);
+//zeroed memory first touched on the kind's cpus, plain calloc when the kind has no list, NULL if out of memory
+void* placement_alloc(int kind, size_t size);
+//with the kind and size it was allocated with
+void placement_free(int kind, void* p, size_t size);
+//from a thread of the kind just before it returns
+void placement_thread_done(int kind);
+void placement_report(void);
+
+#endif
@@ -0,0 +1,195 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <time.h>
+#include "sim.h"
+#include "placement.h"
+
+//worker pool version of the park (M:N)
+//passengers and cars are state records in sim.c, a fixed pool of worker threads runs their events in real time
+//each worker keeps its own calendar of timers, events a worker schedules go back on its own calendar
+//a worker with nothing due steals due events from the others, so a busy worker never holds up the rest
+//no thread per passenger, so -n 1000000 only costs a few small records per passenger
+
+#define STEAL_INTERVAL_NS 1000000LL // idle workers look for work to steal at least this often
+
+typedef struct Pool Pool;
+
+typedef struct {
+    Pool* pool;
+    Calendar cal;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake; // waits on CLOCK_MONOTONIC
+    pthread_t tid;
+} Worker;
+
+struct Pool {
+    Sim* sim;
+    Worker* workers;
+    int num_workers;
+    int next; // round robin target for events posted outside a worker
+    struct timespec start;
+};
+
+static __thread Worker* current_worker = NULL;
+
+static int64_t elapsed_ns(const Pool* pool) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - pool->start.tv_sec) * NS_PER_SEC + (now.tv_nsec - pool->start.tv_nsec);
+}
+
+static void pool_post(Sim* sim, int64_t time, int type, int id, int gen) {
+    Pool* pool = sim->driver;
+    Worker* w = current_worker;
+    if (!w) {
+        w = &pool->workers[pool->next];
+        pool->next = (pool->next + 1) % pool->num_workers;
+    }
+    pthread_mutex_lock(&w->mutex);
+    int earlier = w->cal.len == 0 || time < w->cal.heap[0].time;
+    calendar_push(&w->cal, time, type, id, gen);
+    pthread_mutex_unlock(&w->mutex);
+    if (earlier && w != current_worker) {
+        pthread_cond_signal(&w->wake);
+    }
+}
+
+//pops the first event due by now, returns 0 if there is none
+static int take_due(Worker* w, int64_t now, Event* ev) {
+    int found = 0;
+    pthread_mutex_lock(&w->mutex);
+    if (w->cal.len > 0 && w->cal.heap[0].time <= now) {
+        *ev = calendar_pop(&w->cal);
+        found = 1;
+    }
+    pthread_mutex_unlock(&w->mutex);
+    return found;
+}
+
+static int steal(Pool* pool, Worker* self, int64_t now, Event* ev) {
+    int first = self - pool->workers;
+    for (int i = 1; i < pool->num_workers; ++i) {
+        Worker* victim = &pool->workers[(first + i) % pool->num_workers];
+        if (take_due(victim, now, ev)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//sleep until the next own event, or the steal interval if that comes first
+static void idle(Pool* pool, Worker* w, int64_t now) {
+    int64_t until = now + STEAL_INTERVAL_NS;
+    pthread_mutex_lock(&w->mutex);
+    if (w->cal.len > 0 && w->cal.heap[0].time < until) {
+        until = w->cal.heap[0].time;
+    }
+    if (until > pool->sim->end) {
+        until = pool->sim->end;
+    }
+    if (until > now) {
+        int64_t ns = pool->start.tv_nsec + until;
+        struct timespec deadline = {
+            pool->start.tv_sec + ns / NS_PER_SEC,
+            ns % NS_PER_SEC
+        };
+        pthread_cond_timedwait(&w->wake, &w->mutex, &deadline);
+    }
+    pthread_mutex_unlock(&w->mutex);
+}
+
+static void* worker_thread(void* arg) {
+    Worker* w = arg;
+    Pool* pool = w->pool;
+    current_worker = w;
+    set_virtual_clock(&sim_now); // log lines get the time of their event, to the nanosecond
+
+    while (1) {
+        int64_t now = elapsed_ns(pool);
+        if (now >= pool->sim->end) break;
+
+        Event ev;
+        if (take_due(w, now, &ev) || steal(pool, w, now, &ev)) {
+            sim_now = now;
+            sim_handle(pool->sim, &ev);
+        } else {
+            idle(pool, w, now);
+        }
+    }
+    placement_thread_done(THREADS_PASSENGERS);
+    return NULL;
+}
+
+static int default_workers(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    return cores > 0 ? (int)cores : 1;
+}
+
+int run_pool(const ParkConfig* cfg) {
+    Sim sim;
+    Pool pool;
+    if (sim_init(&sim, cfg)) {
+        return 1;
+    }
+
+    pool.sim = &sim;
+    pool.num_workers = NUM_WORKERS > 0 ? NUM_WORKERS : default_workers();
+    pool.next = 0;
+    pool.workers = calloc(pool.num_workers, sizeof(Worker));
+    if (!pool.workers) {
+        perror("calloc");
+        sim_free(&sim);
+        return 1;
+    }
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    int per_worker = (cfg->passengers + sim.num_cars) / pool.num_workers + 16;
+    for (int i = 0; i < pool.num_workers; ++i) {
+        Worker* w = &pool.workers[i];
+        w->pool = &pool;
+        if (calendar_init(&w->cal, per_worker)) {
+            perror("malloc");
+            exit(1);
+        }
+        pthread_mutex_init(&w->mutex, NULL);
+        pthread_cond_init(&w->wake, &attr);
+    }
+    pthread_condattr_destroy(&attr);
+
+    sim.post = pool_post;
+    sim.driver = &pool;
+
+    printf("Running %d passengers on %d worker threads\n", cfg->passengers, pool.num_workers);
+    clock_gettime(CLOCK_MONOTONIC, &pool.start);
+    sim_now = 0;
+    sim_start(&sim);
+
+    pthread_attr_t worker_attr;
+    pthread_attr_init(&worker_attr);
+    placement_attr(THREADS_PASSENGERS, &worker_attr); // the workers run the passengers
+    for (int i = 0; i < pool.num_workers; ++i) {
+        pthread_create(&pool.workers[i].tid, &worker_attr, worker_thread, &pool.workers[i]);
+    }
+    pthread_attr_destroy(&worker_attr);
+    for (int i = 0; i < pool.num_workers; ++i) {
+        pthread_join(pool.workers[i].tid, NULL);
+    }
+
+    sim_now = elapsed_ns(&pool);
+    sim_finish(&sim);
+    placement_report();
+
+    for (int i = 0; i < pool.num_workers; ++i) {
+        free(pool.workers[i].cal.heap);
+        pthread_mutex_destroy(&pool.workers[i].mutex);
+        pthread_cond_destroy(&pool.workers[i].wake);
+    }
+    free(pool.workers);
+    sim_free(&sim);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <stdio.h>
+#include "park.h"
+#include "hist.h"
+
+//end of day reports, shared by the park and the trace analyzer (analyze.c)
+
+static const char* latency_names[NUM_LATENCIES] = {
+    [LAT_TICKET_WAIT] = "Ticket wait",
+    [LAT_RIDE_WAIT] = "Ride wait",
+    [LAT_CAR_LOAD] = "Car load time",
+    [LAT_CAR_IDLE] = "Car idle time",
+};
+
+void print_latency(int metric, const LatencySummary* l) {
+    printf("  %s p50/p90/p99/p99.9/max: ", latency_names[metric]);
+    const double values[] = { l->p50, l->p90, l->p99, l->p999 };
+    for (int i = 0; i < 4; ++i) {
+        hist_print_ms(0, values[i]);
+        printf("/");
+    }
+    printf("%.1f ms\n", l->max);
+}
+
+void print_final_stats(const ParkStats* s, const ParkConfig* cfg, int duration) {
+    int hh = duration / 3600, mm = (duration % 3600) / 60, ss = duration % 60;
+
+    printf("\n[Monitor] FINAL STATISTICS:\n");
+    printf("Total simulation time: %02d:%02d:%02d\n", hh, mm, ss);
+    printf("Seed: %llu\n", (unsigned long long)cfg->seed);
+    printf("Total passengers: %d\n", s->passengers_served);
+    printf("Total rides completed: %d\n", s->rides_completed);
+    printf("Average wait time in ticket queue: %.1f ms\n",
+        s->ticket_requests ? s->ticket_wait / s->ticket_requests : 0);
+    printf("Average wait time in ride queue: %.1f ms\n",
+        s->ride_requests ? s->ride_wait / s->ride_requests : 0);
+    printf("Average car utilization: %.0f%% (%.1f/%g passengers per ride)\n",
+        s->seats_offered ? (100.0 * s->passengers_served) / s->seats_offered : 0,
+        s->rides_completed ? (1.0 * s->passengers_served) / s->rides_completed : 0,
+        s->rides_completed ? (1.0 * s->seats_offered) / s->rides_completed : 0);
+    //the analyzer passes -1, a trace does not say which policy the park ran
+    if (cfg->dispatch == DISPATCH_TIMEOUT) {
+        printf("Dispatch policy: timeout, leave after %d s\n", cfg->wait_seconds);
+    } else if (cfg->dispatch == DISPATCH_QUEUE && cfg->threshold > 0) {
+        printf("Dispatch policy: queue, leave with %d riders\n", cfg->threshold);
+    } else if (cfg->dispatch == DISPATCH_QUEUE) {
+        printf("Dispatch policy: queue, leave half full\n");
+    } else if (cfg->dispatch == DISPATCH_SLA) {
+        printf("Dispatch policy: sla, leave %d s after the first rider's ticket\n", cfg->target_seconds);
+    } else if (cfg->dispatch == DISPATCH_ADAPTIVE) {
+        printf("Dispatch policy: adaptive\n");
+    }
+    printf("Latency percentiles:\n");
+    for (int m = 0; m < NUM_LATENCIES; ++m) {
+        print_latency(m, &s->latency[m]);
+    }
+}
+
+void print_attraction_stats_line(const AttractionConfig* cfg, int rides, int riders, double ride_wait, int waiting) {
+    printf("Attraction %s: %d cars, %d rides, %d riders, utilization %.0f%%, avg ride wait %.1f ms, %d waiting\n",
+           cfg->name, cfg->cars, rides, riders, rides ? (100.0 * riders) / (rides * cfg->capacity) : 0,
+           riders ? ride_wait / riders : 0, waiting);
+}
+
+void print_booth_stats(const BoothStats* booths, int num_booths, int duration) {
+    for (int i = 0; i < num_booths; ++i) {
+        const BoothStats* b = &booths[i];
+        printf("Booth %d: %d tickets sold, avg service %.1f ms, busy %.0f%%\n", i + 1, b->tickets_sold,
+            b->tickets_sold ? b->service_time / b->tickets_sold : 0,
+            duration ? b->service_time / (duration * 10.0) : 0);
+    }
+}
+
+void print_startup_stats(int threads, int stack_kb, double start_ms, double shutdown_ms) {
+    printf("Threads: %d started in %.1f ms with %d KB stacks, shut down in %.1f ms\n",
+           threads, start_ms, stack_kb, shutdown_ms);
+}
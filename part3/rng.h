@@ -0,0 +1,18 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+//xoshiro256** generator, one per passenger so nobody shares (or locks) a generator
+//streams are seeded from (seed, stream) through splitmix64, the same pair always gives the same numbers
+
+typedef struct {
+    uint64_t s[4];
+} Rng;
+
+void rng_seed(Rng* rng, uint64_t seed, uint64_t stream);
+uint64_t rng_next(Rng* rng);
+int rng_range(Rng* rng, int lo, int hi); // uniform in [lo, hi]
+double rng_double(Rng* rng); // uniform in [0, 1)
+
+#endif
@@ -0,0 +1,440 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include "sim.h"
+#include "log.h"
+
+//multi-process park (--shards n), the -A attractions are dealt round robin to n forked shard processes
+//each shard is a virtual time park of its attractions with its share of the booths, the passengers and the --arrivals rate
+//a guest that picks an attraction of another shard walks there for WINDOW of park time and joins that shard's ticket line
+//the day runs in windows of WINDOW: every shard handles its events up to the end of the window and reports,
+//the coordinator (the parent process) prints the merged monitor statistics, then the shards take in the guests that
+//walked over and go on with the next window
+//a walk never ends in the window it started in, so no shard gets a guest from its past and a seeded day always gives the same figures
+//all of it passes through shared memory mapped before the fork: mailboxes of walking guests, per shard figures and semaphores
+//a shard that dies is left out from then on, its last figures stay in the totals and guests stop walking to it
+//no event log, --trace, --export or checkpoints, they follow a single process
+
+#define WINDOW (MONITOR_INTERVAL * NS_PER_SEC)
+#define POLL_NS 100000000LL // how often the coordinator checks that a late shard is still alive
+#define MAILBOX_SLACK 4096  // walking guests a mailbox takes over an even share of the passengers
+
+typedef struct {
+    int64_t time;   // reaches the ticket line
+    int from;       // shard and send order, so guests are taken in the same order every run
+    int seq;
+    int attraction; // index in the receiving shard
+    int rides;
+    int64_t wait;
+    Passenger state;
+} Migrant;
+
+//guests walking to one shard in one window, any shard adds to it, the receiver empties it between windows
+//a full mailbox keeps the guest where it is
+typedef struct {
+    atomic_int count;
+    int size;
+    Migrant* items;
+} Mailbox;
+
+typedef struct {
+    sem_t go;   // coordinator to shard, take in the walkers and run the next window
+    sem_t done; // shard to coordinator, the window is over and the figures below are current
+    pid_t pid;
+    atomic_int alive;
+    StatsTotals stats;
+    GuestTotals guests;
+    int arrived;
+    int left;
+    int in_park;
+    int records;
+    int moved_out;
+} ShardSlot;
+
+//one per attraction of the whole park, written by the shard that runs it
+typedef struct {
+    int rides;
+    int riders;
+    int waiting;
+    double ride_wait; // ms
+    int line[2];      // ride line at the end of the last two windows, the other shards read the finished one
+} AttractionSlot;
+
+typedef struct {
+    int num_shards;
+    const ParkConfig* cfg;
+    int total_popularity;
+    ShardSlot* slots;         // shared from here on
+    AttractionSlot* rides;
+    Mailbox* boxes;           // [window parity][shard]
+    BoothStats* booths;       // every shard has a range, from first_booth[shard]
+    int* first_booth;         // private, set before the fork
+} Shards;
+
+//the shard this process runs
+static Shards* park;
+static int self;
+static int window; // windows done
+static int sent;
+
+static void* shared(size_t size) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        perror("mmap");
+        exit(1);
+    }
+    return p;
+}
+
+//length of a ride line, live for this shard's attractions and as of the last window for the others
+static int line_length(Sim* sim, int a) {
+    int n = park->num_shards;
+    if (a % n == self) {
+        return atomic_load_explicit(&sim->attractions[a / n].waiting, memory_order_relaxed);
+    }
+    return park->rides[a].line[window & 1];
+}
+
+//-P over the attractions of the whole park
+static int pick(Sim* sim, Passenger* passenger) {
+    const ParkConfig* cfg = park->cfg;
+    int n = cfg->num_attractions;
+    switch (cfg->policy) {
+        case PICK_SHORTEST: {
+            int start = rng_range(&passenger->rng, 0, n - 1); // ties go to a random one
+            int best = start;
+            int best_len = line_length(sim, start);
+            for (int i = 1; i < n; ++i) {
+                int a = (start + i) % n;
+                int len = line_length(sim, a);
+                if (len < best_len) {
+                    best = a;
+                    best_len = len;
+                }
+            }
+            return best;
+        }
+        case PICK_WEIGHTED: {
+            int r = rng_range(&passenger->rng, 0, park->total_popularity - 1);
+            for (int a = 0; a < n; ++a) {
+                r -= cfg->attractions[a].popularity;
+                if (r < 0) {
+                    return a;
+                }
+            }
+            return n - 1;
+        }
+        default:
+            return rng_range(&passenger->rng, 0, n - 1);
+    }
+}
+
+static int shard_route(Sim* sim, int p) {
+    Passenger* passenger = sim_passenger(sim, p);
+    int a = pick(sim, passenger);
+    int to = a % park->num_shards;
+    if (to == self) {
+        return a / park->num_shards;
+    }
+    Mailbox* box = &park->boxes[(window & 1) * park->num_shards + to];
+    int i;
+    if (!atomic_load_explicit(&park->slots[to].alive, memory_order_relaxed) ||
+        (i = atomic_fetch_add_explicit(&box->count, 1, memory_order_relaxed)) >= box->size) {
+        return rng_range(&passenger->rng, 0, sim->num_attractions - 1); // stays, at one of this shard's rides
+    }
+    const GuestChunk* row = sim->guest_table.chunks[p >> GUEST_CHUNK_BITS];
+    Migrant* m = &box->items[i];
+    m->time = sim_now + WINDOW;
+    m->from = self;
+    m->seq = sent++;
+    m->attraction = a / park->num_shards;
+    m->rides = row->rides[p & (GUEST_CHUNK - 1)];
+    m->wait = row->wait[p & (GUEST_CHUNK - 1)];
+    m->state = *passenger;
+    return -1;
+}
+
+static void publish(Sim* sim) {
+    ShardSlot* slot = &park->slots[self];
+    stats_totals(sim->stats, &slot->stats);
+    guests_totals(&sim->guest_table, sim_now, &slot->guests);
+    slot->arrived = sim->arrived;
+    slot->left = sim->left;
+    slot->in_park = sim->guests;
+    slot->records = sim->num_records;
+    slot->moved_out = sim->moved_out;
+    memcpy(&park->booths[park->first_booth[self]], sim->booth_stats, sizeof(BoothStats) * sim->cfg.booths);
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        AttractionSlot* r = &park->rides[i * park->num_shards + self];
+        r->rides = a->rides;
+        r->riders = a->riders;
+        r->ride_wait = a->ride_wait;
+        r->waiting = a->ride_queue.count;
+        r->line[(window + 1) & 1] = a->ride_queue.count;
+    }
+}
+
+static int by_sender(const void* a, const void* b) {
+    const Migrant* x = a;
+    const Migrant* y = b;
+    return x->from != y->from ? x->from - y->from : x->seq - y->seq;
+}
+
+//end of a window, sim_now is on the boundary and no event past it has run
+static int shard_check(Sim* sim, void* ctx) {
+    (void)ctx;
+    ShardSlot* slot = &park->slots[self];
+    publish(sim);
+    sem_post(&slot->done);
+    while (sem_wait(&slot->go) != 0) {
+    }
+    Mailbox* box = &park->boxes[(window & 1) * park->num_shards + self];
+    int count = atomic_load(&box->count);
+    count = count < box->size ? count : box->size;
+    qsort(box->items, count, sizeof(Migrant), by_sender);
+    for (int i = 0; i < count; ++i) {
+        Migrant* m = &box->items[i];
+        sim_take_guest(sim, &m->state, m->attraction, m->rides, m->wait, m->time);
+    }
+    atomic_store(&box->count, 0);
+    window++;
+    return 0;
+}
+
+static void run_shard(const ParkConfig* cfg) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL); // no coordinator, nobody to finish the day for
+    Sim sim;
+    if (sim_init(&sim, cfg)) {
+        _exit(1);
+    }
+    sim.quiet = 1;
+    sim.route = shard_route;
+    sim.stream_stride = park->num_shards;
+    sim.stream_offset = self;
+    rng_seed(&sim.arrival_rng, cfg->seed, UINT64_MAX - self); // each shard its own Poisson stream, they add up to the whole rate
+    sim.check = shard_check;
+    sim.check_interval = WINDOW;
+    if (sim_run_virtual(&sim)) {
+        _exit(1);
+    }
+    publish(&sim);
+    sem_post(&park->slots[self].done);
+    _exit(0);
+}
+
+//waits for the shard to finish its window, 0 if it died instead
+static int wait_shard(int k, int64_t now) {
+    ShardSlot* slot = &park->slots[k];
+    while (1) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += POLL_NS;
+        if (deadline.tv_nsec >= NS_PER_SEC) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= NS_PER_SEC;
+        }
+        if (sem_timedwait(&slot->done, &deadline) == 0) {
+            return 1;
+        }
+        int status;
+        if (errno == ETIMEDOUT && waitpid(slot->pid, &status, WNOHANG) == slot->pid) {
+            atomic_store(&slot->alive, 0);
+            int t = now / NS_PER_SEC;
+            fprintf(stderr, "Shard %d %s %d before %02d:%02d:%02d, carrying on without it\n", k + 1,
+                    WIFSIGNALED(status) ? "killed by signal" : "exited with", WIFSIGNALED(status) ? WTERMSIG(status)
+                    : WEXITSTATUS(status), t / 3600, (t % 3600) / 60, t % 60);
+            return 0;
+        }
+    }
+}
+
+//the figures every shard published last, a dead shard's as of its last window
+static void merge(Stats* stats, GuestTotals* guests, ParkStats* s, GuestSummary* g) {
+    stats_init(stats);
+    memset(guests, 0, sizeof(*guests));
+    for (int k = 0; k < park->num_shards; ++k) {
+        stats_add_totals(stats, &park->slots[k].stats);
+        guests_add_totals(guests, &park->slots[k].guests);
+    }
+    stats_read(stats, s);
+    guests_summary(guests, g);
+}
+
+static ParkConfig shard_config(const ParkConfig* cfg, int k, int n) {
+    ParkConfig c = *cfg;
+    AttractionConfig* list = malloc(sizeof(AttractionConfig) * (cfg->num_attractions / n + 1));
+    ArrivalPoint* arrivals = cfg->arrivals ? malloc(sizeof(ArrivalPoint) * cfg->num_arrivals) : NULL;
+    if (!list || (cfg->arrivals && !arrivals)) {
+        perror("malloc");
+        exit(1);
+    }
+    c.num_attractions = 0;
+    for (int a = k; a < cfg->num_attractions; a += n) {
+        list[c.num_attractions++] = cfg->attractions[a];
+    }
+    c.attractions = list;
+    c.passengers = cfg->passengers / n + (k < cfg->passengers % n);
+    c.booths = cfg->booths / n + (k < cfg->booths % n);
+    if (c.booths < 1) {
+        c.booths = 1;
+    }
+    //n independent Poisson streams of a nth of the rate each add up to the park's
+    for (int i = 0; i < cfg->num_arrivals && arrivals; ++i) {
+        arrivals[i] = cfg->arrivals[i];
+        arrivals[i].rate /= n;
+    }
+    c.arrivals = arrivals;
+    return c;
+}
+
+int run_shards(const ParkConfig* cfg, int num_shards) {
+    if (cfg->num_attractions < num_shards) {
+        fprintf(stderr, "--shards %d needs -A with at least %d attractions, a shard runs whole attractions\n",
+                num_shards, num_shards);
+        return 1;
+    }
+    int n = num_shards;
+    park = calloc(1, sizeof(Shards));
+    ParkConfig* configs = malloc(sizeof(ParkConfig) * n);
+    if (!park || !configs) {
+        perror("malloc");
+        exit(1);
+    }
+    park->num_shards = n;
+    park->cfg = cfg;
+    for (int a = 0; a < cfg->num_attractions; ++a) {
+        park->total_popularity += cfg->attractions[a].popularity;
+    }
+    park->first_booth = malloc(sizeof(int) * (n + 1));
+    park->first_booth[0] = 0;
+    for (int k = 0; k < n; ++k) {
+        configs[k] = shard_config(cfg, k, n);
+        park->first_booth[k + 1] = park->first_booth[k] + configs[k].booths;
+    }
+    park->slots = shared(sizeof(ShardSlot) * n);
+    park->rides = shared(sizeof(AttractionSlot) * cfg->num_attractions);
+    park->booths = shared(sizeof(BoothStats) * park->first_booth[n]);
+    park->boxes = shared(sizeof(Mailbox) * 2 * n);
+    int box_size = cfg->passengers / n + MAILBOX_SLACK;
+    for (int i = 0; i < 2 * n; ++i) {
+        atomic_init(&park->boxes[i].count, 0);
+        park->boxes[i].size = box_size;
+        park->boxes[i].items = shared(sizeof(Migrant) * box_size); // pages are only backed once written
+    }
+
+    //the shards print nothing, the coordinator prints for all of them
+    log_level = LOG_STATS;
+    fflush(stdout);
+    for (int k = 0; k < n; ++k) {
+        ShardSlot* slot = &park->slots[k];
+        sem_init(&slot->go, 1, 0);
+        sem_init(&slot->done, 1, 0);
+        atomic_init(&slot->alive, 1);
+        pid_t pid = fork(); // not straight into the slot, the child would write its 0 over the parent's pid
+        if (pid < 0) {
+            perror("fork");
+            for (int j = 0; j < k; ++j) {
+                kill(park->slots[j].pid, SIGKILL);
+            }
+            return 1;
+        }
+        if (pid == 0) {
+            self = k;
+            run_shard(&configs[k]);
+        }
+        slot->pid = pid;
+    }
+
+    Stats* stats = stats_new();
+    GuestTotals* guests = malloc(sizeof(GuestTotals));
+    if (!guests) {
+        perror("malloc");
+        exit(1);
+    }
+    ParkStats s;
+    GuestSummary g;
+    int64_t end = (int64_t)cfg->sim_seconds * NS_PER_SEC;
+    int64_t now = 0;
+    int peak = 0;
+    set_virtual_clock(&now);
+    for (int64_t t = WINDOW;; t += WINDOW) {
+        now = t < end ? t : end;
+        for (int k = 0; k < n; ++k) {
+            if (atomic_load(&park->slots[k].alive)) {
+                wait_shard(k, now);
+            }
+        }
+        int in_park = 0;
+        for (int k = 0; k < n; ++k) {
+            in_park += park->slots[k].in_park;
+        }
+        peak = in_park > peak ? in_park : peak;
+        if (t >= end) {
+            break;
+        }
+        merge(stats, guests, &s, &g);
+        print_monitor_stats(&s, &g);
+        for (int k = 0; k < n; ++k) {
+            if (atomic_load(&park->slots[k].alive)) {
+                sem_post(&park->slots[k].go);
+            }
+        }
+    }
+
+    int failed = 0;
+    for (int k = 0; k < n; ++k) {
+        int status;
+        if (!atomic_load(&park->slots[k].alive)) {
+            failed = 1; // reaped by wait_shard
+        } else if (waitpid(park->slots[k].pid, &status, 0) != park->slots[k].pid || !WIFEXITED(status) ||
+                   WEXITSTATUS(status) != 0) {
+            failed = 1;
+        }
+    }
+
+    merge(stats, guests, &s, &g);
+    int duration = end / NS_PER_SEC;
+    print_final_stats(&s, cfg, duration);
+    print_booth_stats(park->booths, park->first_booth[n], duration);
+    for (int a = 0; a < cfg->num_attractions; ++a) {
+        AttractionSlot* r = &park->rides[a];
+        print_attraction_stats_line(&cfg->attractions[a], r->rides, r->riders, r->ride_wait, r->waiting);
+    }
+    int arrived = 0, left = 0, in_park = 0, records = 0, moved = 0;
+    for (int k = 0; k < n; ++k) {
+        ShardSlot* slot = &park->slots[k];
+        arrived += slot->arrived;
+        left += slot->left;
+        in_park += slot->in_park;
+        records += slot->records;
+        moved += slot->moved_out;
+    }
+    if (cfg->arrivals) {
+        //the peak is sampled at the end of each window
+        printf("Guests: %d arrived, %d left, %d in the park at closing, peak %d, %d passenger records\n",
+               arrived, left, in_park, peak, records);
+    }
+    printf("Shards: %d processes, %d walks between them%s\n", n, moved, failed ? ", some shards failed" : "");
+    set_virtual_clock(NULL);
+
+    free(guests);
+    stats_free(stats);
+    for (int k = 0; k < n; ++k) {
+        free((void*)configs[k].attractions);
+        free((void*)configs[k].arrivals);
+    }
+    free(configs);
+    free(park->first_booth);
+    free(park);
+    return failed;
+}
@@ -0,0 +1,794 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <math.h>
+#include "sim.h"
+#include "log.h"
+#include "export.h"
+#include "checkpoint.h"
+#include "placement.h"
+
+//virtual time version of the park
+//same passenger/car/monitor logic as the threaded version, but nothing sleeps
+//every delay becomes an event on a calendar (binary min-heap) and the clock jumps to the next event
+//passenger: explore -> ticket queue (NUM_BOOTHS booths, 1 second each) -> ride queue -> board -> ride -> unboard -> repeat
+//car: wait for the platform -> load until full or the -D policy lets it go (WAIT_SECONDS at most) -> ride RIDE_SECONDS -> unload -> repeat
+//up to NUM_PLATFORMS cars loading at a time, FIFO order for tickets, boarding and the platforms
+//passengers board the car that has been loading the longest
+//the park has one or more attractions (-A file), each with its own lock, ride queue, cars and platforms
+//after exploring a passenger picks the next attraction by the -P policy, tickets are sold for all of them at the same booths
+//the model itself is driver agnostic, pool.c runs the same handlers on worker threads in real time
+
+__thread int64_t sim_now;
+
+static int queue_init(Queue* q, int size) {
+    q->size = size > 16 ? size : 16;
+    q->items = malloc(sizeof(int) * q->size);
+    q->head = 0;
+    q->count = 0;
+    return q->items ? 0 : -1;
+}
+
+//grows when full, a queue only ever costs as much as the longest line it held
+static void queue_push(Queue* q, int id) {
+    if (q->count == q->size) {
+        int* items = malloc(sizeof(int) * q->size * 2);
+        if (!items) {
+            perror("malloc");
+            exit(1);
+        }
+        for (int i = 0; i < q->count; ++i) {
+            items[i] = q->items[(q->head + i) % q->size];
+        }
+        free(q->items);
+        q->items = items;
+        q->head = 0;
+        q->size *= 2;
+    }
+    q->items[(q->head + q->count) % q->size] = id;
+    q->count++;
+}
+
+static int queue_pop(Queue* q) {
+    int id = q->items[q->head];
+    q->head = (q->head + 1) % q->size;
+    q->count--;
+    return id;
+}
+
+static int event_before(const Event* a, const Event* b) {
+    return a->time < b->time || (a->time == b->time && a->seq < b->seq);
+}
+
+int calendar_init(Calendar* cal, int size) {
+    cal->size = size > 16 ? size : 16;
+    cal->len = 0;
+    cal->seq = 0;
+    cal->heap = malloc(sizeof(Event) * cal->size);
+    return cal->heap ? 0 : -1;
+}
+
+void calendar_push(Calendar* cal, int64_t time, int type, int id, int gen) {
+    if (cal->len == cal->size) {
+        cal->size *= 2;
+        cal->heap = realloc(cal->heap, sizeof(Event) * cal->size);
+        if (!cal->heap) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+    Event ev = { time, cal->seq++, type, id, gen };
+    int i = cal->len++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!event_before(&ev, &cal->heap[parent])) break;
+        cal->heap[i] = cal->heap[parent];
+        i = parent;
+    }
+    cal->heap[i] = ev;
+}
+
+Event calendar_pop(Calendar* cal) {
+    Event top = cal->heap[0];
+    Event last = cal->heap[--cal->len];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= cal->len) break;
+        if (child + 1 < cal->len && event_before(&cal->heap[child + 1], &cal->heap[child])) {
+            child++;
+        }
+        if (!event_before(&cal->heap[child], &last)) break;
+        cal->heap[i] = cal->heap[child];
+        i = child;
+    }
+    cal->heap[i] = last;
+    return top;
+}
+
+static void schedule(Sim* sim, int64_t delay, int type, int id, int gen) {
+    sim->post(sim, sim_now + delay, type, id, gen);
+}
+
+static void start_exploring(Sim* sim, int p) {
+    Passenger* passenger = sim_passenger(sim, p);
+    int explore_time = rng_range(&passenger->rng, 1, 5);
+    passenger->phase = P_EXPLORING;
+    guest_phase(&sim->guest_table, p, GUEST_EXPLORING);
+    log_event(LOG_EXPLORING, p + 1, explore_time, 0, 0);
+    schedule(sim, explore_time * NS_PER_SEC, EV_EXPLORE_DONE, p, 0);
+}
+
+//must hold ticket_lock
+static void serve_next_ticket(Sim* sim) {
+    while (sim->free_booths > 0 && sim->ticket_queue.count > 0) {
+        int p = queue_pop(&sim->ticket_queue);
+        int booth = 0;
+        while (sim->booths[booth] >= 0) {
+            booth++;
+        }
+        sim->booths[booth] = p;
+        sim->free_booths--;
+        Passenger* passenger = sim_passenger(sim, p);
+        passenger->booth = booth;
+        passenger->service_start = sim_now;
+        log_event(LOG_GETTING_TICKET, p + 1, booth + 1, 0, 0);
+        schedule(sim, NS_PER_SEC, EV_TICKET_DONE, p, 0);
+    }
+}
+
+//must hold the attraction's lock for the rest of the car/boarding helpers
+static void depart(Sim* sim, int c) {
+    Car* car = &sim->cars[c];
+    Attraction* a = &sim->attractions[car->attraction];
+    car->phase = C_RIDING;
+    car->gen++;
+    a->platforms[car->platform] = -1;
+    for (int i = 0; i < a->loading_count; ++i) {
+        if (a->loading[i] == c) {
+            memmove(&a->loading[i], &a->loading[i + 1], sizeof(int) * (a->loading_count - i - 1));
+            a->loading_count--;
+            break;
+        }
+    }
+
+    log_event(LOG_CAR_RUNNING, c + 1, 0, 0, 0);
+    a->rides++;
+    a->riders += car->boarded;
+    stats_ride(sim->stats, car->boarded, a->cfg.capacity);
+    stats_latency(sim->stats, LAT_CAR_LOAD, sim_now - car->since);
+    schedule(sim, a->cfg.ride_seconds * NS_PER_SEC, EV_RIDE_DONE, c, 0);
+}
+
+static void board(Sim* sim, int c, int p) {
+    Car* car = &sim->cars[c];
+    Attraction* a = &sim->attractions[car->attraction];
+    Passenger* passenger = sim_passenger(sim, p);
+
+    int64_t wait = sim_now - passenger->ride_start;
+    stats_ride_wait(sim->stats, wait);
+    a->ride_wait += wait / 1e6;
+    guest_waited(&sim->guest_table, p, wait);
+    guest_rode(&sim->guest_table, p);
+
+    passenger->phase = P_RIDING;
+    if (car->boarded == 0 || passenger->ride_start < car->first_ticket) {
+        car->first_ticket = passenger->ride_start;
+    }
+    car->riders[car->boarded++] = p;
+    log_event(LOG_BOARDED, p + 1, c + 1, car->boarded, a->cfg.capacity);
+}
+
+//asks the -D policy again after the riders aboard changed, a car leaving early goes through a timeout event now
+//only the timeout at car->deadline is live, the ones it replaced are ignored when they come
+static void redispatch(Sim* sim, int c) {
+    Car* car = &sim->cars[c];
+    Attraction* a = &sim->attractions[car->attraction];
+    int64_t deadline = dispatch_deadline(&a->dispatch, car->boarded, car->since, car->first_ticket, &a->rate, sim_now);
+    if (deadline < sim_now) {
+        deadline = sim_now;
+    }
+    if (deadline < car->deadline) {
+        car->deadline = deadline;
+        schedule(sim, deadline - sim_now, EV_LOAD_TIMEOUT, c, car->gen);
+    }
+}
+
+static void start_loading(Sim* sim, int c) {
+    Car* car = &sim->cars[c];
+    Attraction* a = &sim->attractions[car->attraction];
+    car->phase = C_LOADING;
+    car->boarded = 0;
+    stats_latency(sim->stats, LAT_CAR_IDLE, sim_now - car->since);
+    car->since = sim_now;
+    car->platform = 0;
+    while (a->platforms[car->platform] >= 0) {
+        car->platform++;
+    }
+    a->platforms[car->platform] = c;
+    a->loading[a->loading_count++] = c;
+
+    log_event(LOG_CAR_LOADING, c + 1, car->platform + 1, 0, 0);
+    while (car->boarded < a->cfg.capacity && a->ride_queue.count > 0) {
+        board(sim, c, queue_pop(&a->ride_queue));
+    }
+    atomic_store_explicit(&a->waiting, a->ride_queue.count, memory_order_relaxed);
+    if (car->boarded >= a->cfg.capacity) {
+        depart(sim, c);
+    } else {
+        car->deadline = INT64_MAX;
+        redispatch(sim, c);
+    }
+}
+
+//cars take the platforms in arrival order, a car that fills up right away frees its platform for the next one
+static void next_car(Sim* sim, Attraction* a) {
+    while (a->loading_count < a->cfg.platforms && a->car_queue.count > 0) {
+        start_loading(sim, queue_pop(&a->car_queue));
+    }
+}
+
+static void car_arrive(Sim* sim, int c) {
+    Attraction* a = &sim->attractions[sim->cars[c].attraction];
+    sim->cars[c].phase = C_WAITING;
+    sim->cars[c].since = sim_now;
+    queue_push(&a->car_queue, c);
+    next_car(sim, a);
+}
+
+//reads other attractions' queue lengths without their locks, a slightly stale length is fine for picking
+static int pick_attraction(Sim* sim, Passenger* passenger) {
+    int n = sim->num_attractions;
+    if (n == 1) {
+        return 0;
+    }
+    switch (sim->cfg.policy) {
+        case PICK_SHORTEST: {
+            int start = rng_range(&passenger->rng, 0, n - 1); // ties go to a random one
+            int best = start;
+            int best_len = atomic_load_explicit(&sim->attractions[start].waiting, memory_order_relaxed);
+            for (int i = 1; i < n; ++i) {
+                int a = (start + i) % n;
+                int len = atomic_load_explicit(&sim->attractions[a].waiting, memory_order_relaxed);
+                if (len < best_len) {
+                    best = a;
+                    best_len = len;
+                }
+            }
+            return best;
+        }
+        case PICK_WEIGHTED: {
+            int r = rng_range(&passenger->rng, 0, sim->total_popularity - 1);
+            for (int a = 0; a < n; ++a) {
+                r -= sim->attractions[a].cfg.popularity;
+                if (r < 0) {
+                    return a;
+                }
+            }
+            return n - 1;
+        }
+        default:
+            return rng_range(&passenger->rng, 0, n - 1);
+    }
+}
+
+//hands out a passenger record, recycled if a guest left, and the guest table row that goes with it
+static int take_record(Sim* sim, int moved) {
+    pthread_mutex_lock(&sim->guest_lock);
+    int p = sim->free_passenger;
+    if (p >= 0) {
+        sim->free_passenger = sim_passenger(sim, p)->next_free;
+    } else {
+        p = sim->num_records++;
+        int chunk = p >> PASSENGER_CHUNK_BITS;
+        if (chunk >= MAX_PASSENGER_CHUNKS) {
+            fprintf(stderr, "more than %d passengers in the park at once\n", MAX_PASSENGER_CHUNKS * PASSENGER_CHUNK);
+            exit(1);
+        }
+        if (!sim->chunks[chunk]) {
+            sim->chunks[chunk] = calloc(PASSENGER_CHUNK, sizeof(Passenger));
+            if (!sim->chunks[chunk]) {
+                perror("calloc");
+                exit(1);
+            }
+        }
+    }
+    int guest = sim->arrived;
+    if (moved) {
+        sim->moved_in++;
+    } else {
+        sim->arrived++;
+    }
+    guests_admit(&sim->guest_table, p);
+    if (++sim->guests > sim->peak_guests) {
+        sim->peak_guests = sim->guests;
+    }
+    pthread_mutex_unlock(&sim->guest_lock);
+    sim_passenger(sim, p)->guest = guest; // a guest walking in keeps the number it arrived with
+    return p;
+}
+
+//a new guest through the gate, starts the guest's random stream
+static int admit(Sim* sim) {
+    int p = take_record(sim, 0);
+    Passenger* passenger = sim_passenger(sim, p);
+    int guest = passenger->guest;
+    rng_seed(&passenger->rng, sim->cfg.seed, (uint64_t)guest * sim->stream_stride + sim->stream_offset);
+    passenger->rides_left = -1;
+    if (sim->cfg.arrivals) {
+        int mean = sim->cfg.rides_per_visit > 0 ? sim->cfg.rides_per_visit : 1;
+        passenger->rides_left = rng_range(&passenger->rng, 1, 2 * mean - 1);
+        log_event(LOG_ARRIVED, p + 1, guest + 1, 0, 0);
+    }
+    return p;
+}
+
+//after a ride the passenger explores again, or leaves the park for good after their last one
+static void ride_over(Sim* sim, int p) {
+    Passenger* passenger = sim_passenger(sim, p);
+    if (passenger->rides_left < 0 || --passenger->rides_left > 0) {
+        start_exploring(sim, p);
+        return;
+    }
+    log_event(LOG_LEFT, p + 1, 0, 0, 0);
+    guests_left(&sim->guest_table, p);
+    pthread_mutex_lock(&sim->guest_lock);
+    passenger->next_free = sim->free_passenger;
+    sim->free_passenger = p;
+    sim->guests--;
+    sim->left++;
+    pthread_mutex_unlock(&sim->guest_lock);
+}
+
+//the route hook sent the guest to another shard, its record is free again
+static void move_out(Sim* sim, int p) {
+    Passenger* passenger = sim_passenger(sim, p);
+    guest_moved_out(&sim->guest_table, p);
+    pthread_mutex_lock(&sim->guest_lock);
+    passenger->next_free = sim->free_passenger;
+    sim->free_passenger = p;
+    sim->guests--;
+    sim->moved_out++;
+    pthread_mutex_unlock(&sim->guest_lock);
+}
+
+void sim_take_guest(Sim* sim, const Passenger* state, int attraction, int rides, int64_t wait, int64_t at) {
+    int p = take_record(sim, 1);
+    Passenger* passenger = sim_passenger(sim, p);
+    *passenger = *state;
+    passenger->attraction = attraction;
+    passenger->phase = P_EXPLORING;
+    guest_moved_in(&sim->guest_table, p, rides, wait);
+    sim->post(sim, at, EV_WALK_DONE, p, 0);
+}
+
+//after exploring, or after walking in from another shard with the attraction already picked
+static void join_ticket_line(Sim* sim, int p) {
+    Passenger* passenger = sim_passenger(sim, p);
+    passenger->phase = P_TICKET;
+    guest_joined(&sim->guest_table, p, GUEST_TICKET, sim_now);
+    passenger->ticket_start = sim_now;
+    pthread_mutex_lock(&sim->ticket_lock);
+    queue_push(&sim->ticket_queue, p);
+    serve_next_ticket(sim);
+    pthread_mutex_unlock(&sim->ticket_lock);
+}
+
+//piecewise Poisson arrivals, each piece of the schedule has a constant rate
+//a draw that runs past the end of its piece starts over at the next one, which exponential gaps allow
+//returns INT64_MAX if nobody else arrives before closing
+static int64_t next_arrival(Sim* sim, int64_t t) {
+    const ArrivalPoint* points = sim->cfg.arrivals;
+    int n = sim->cfg.num_arrivals;
+    const int64_t day = 24 * 3600 * NS_PER_SEC;
+    while (t < sim->end) {
+        int64_t midnight = t - t % day;
+        int i = n - 1;
+        while (i >= 0 && (int64_t)(points[i].start * 3600 * NS_PER_SEC) > t - midnight) {
+            i--;
+        }
+        int64_t piece_end = i + 1 < n ? midnight + (int64_t)(points[i + 1].start * 3600 * NS_PER_SEC)
+                                      : midnight + day + (int64_t)(points[0].start * 3600 * NS_PER_SEC);
+        double rate = points[i >= 0 ? i : n - 1].rate; // before the first point the last rate of the day before holds
+        if (rate > 0) {
+            int64_t gap = -log(1 - rng_double(&sim->arrival_rng)) * 3600 * NS_PER_SEC / rate;
+            if (t + gap < piece_end) {
+                return t + gap;
+            }
+        }
+        t = piece_end;
+    }
+    return INT64_MAX;
+}
+
+static void schedule_arrival(Sim* sim) {
+    int64_t next = next_arrival(sim, sim_now);
+    if (next < sim->end) {
+        sim->post(sim, next, EV_ARRIVAL, 0, 0);
+    }
+}
+
+void sim_snapshot(Sim* sim, ParkStats* out) {
+    stats_read(sim->stats, out);
+}
+
+//ride waits are only recorded at boarding, a line that keeps growing hides its worst waits until then
+void sim_queued_waits(Sim* sim, Histogram* out) {
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        pthread_mutex_lock(&a->lock);
+        for (int j = 0; j < a->ride_queue.count; ++j) {
+            int p = a->ride_queue.items[(a->ride_queue.head + j) % a->ride_queue.size];
+            hist_record(out, sim_now - sim_passenger(sim, p)->ride_start);
+        }
+        pthread_mutex_unlock(&a->lock);
+    }
+}
+
+void sim_handle(Sim* sim, const Event* ev) {
+    switch (ev->type) {
+        case EV_EXPLORE_DONE: {
+            Passenger* passenger = sim_passenger(sim, ev->id);
+            int a = sim->route ? sim->route(sim, ev->id) : pick_attraction(sim, passenger);
+            if (a < 0) {
+                move_out(sim, ev->id);
+                break;
+            }
+            passenger->attraction = a;
+            join_ticket_line(sim, ev->id);
+            break;
+        }
+        case EV_WALK_DONE:
+            join_ticket_line(sim, ev->id);
+            break;
+        case EV_TICKET_DONE: {
+            Passenger* passenger = sim_passenger(sim, ev->id);
+            stats_ticket(sim->stats, sim_now - passenger->ticket_start);
+            guest_waited(&sim->guest_table, ev->id, sim_now - passenger->ticket_start);
+            log_event(LOG_GOT_TICKET, ev->id + 1, 0, 0, 0);
+
+            pthread_mutex_lock(&sim->ticket_lock);
+            BoothStats* booth = &sim->booth_stats[passenger->booth];
+            booth->tickets_sold++;
+            booth->service_time += (sim_now - passenger->service_start) / 1e6;
+            sim->booths[passenger->booth] = -1;
+            sim->free_booths++;
+            serve_next_ticket(sim);
+            pthread_mutex_unlock(&sim->ticket_lock);
+
+            passenger->phase = P_QUEUED;
+            guest_joined(&sim->guest_table, ev->id, GUEST_QUEUED, sim_now);
+            passenger->ride_start = sim_now;
+            Attraction* a = &sim->attractions[passenger->attraction];
+            pthread_mutex_lock(&a->lock);
+            rate_observe(&a->rate, sim_now);
+            if (a->loading_count > 0) {
+                int c = a->loading[0];
+                board(sim, c, ev->id);
+                if (sim->cars[c].boarded >= a->cfg.capacity) {
+                    depart(sim, c);
+                    next_car(sim, a);
+                } else {
+                    redispatch(sim, c);
+                }
+            } else {
+                queue_push(&a->ride_queue, ev->id);
+                atomic_store_explicit(&a->waiting, a->ride_queue.count, memory_order_relaxed);
+            }
+            pthread_mutex_unlock(&a->lock);
+            break;
+        }
+        case EV_LOAD_TIMEOUT: {
+            Car* car = &sim->cars[ev->id];
+            Attraction* a = &sim->attractions[car->attraction];
+            pthread_mutex_lock(&a->lock);
+            //otherwise it already left, or a later timeout replaced this one
+            if (car->phase == C_LOADING && car->gen == ev->gen && ev->time == car->deadline) {
+                int64_t deadline = dispatch_deadline(&a->dispatch, car->boarded, car->since, car->first_ticket,
+                                                     &a->rate, sim_now);
+                if (deadline > sim_now) {
+                    car->deadline = deadline; // the policy wants to wait longer, e.g. riders came slower than expected
+                    schedule(sim, deadline - sim_now, EV_LOAD_TIMEOUT, ev->id, car->gen);
+                } else {
+                    if (sim_now >= car->since + a->dispatch.max_wait) {
+                        log_event(LOG_CAR_TIMEOUT, ev->id + 1, car->boarded, a->cfg.capacity, 0);
+                    }
+                    depart(sim, ev->id);
+                    next_car(sim, a);
+                }
+            }
+            pthread_mutex_unlock(&a->lock);
+            break;
+        }
+        case EV_RIDE_DONE: {
+            //a riding car belongs to this event alone, only the platforms need the attraction's lock
+            Car* car = &sim->cars[ev->id];
+            for (int i = 0; i < car->boarded; ++i) {
+                log_event(LOG_UNBOARDED, car->riders[i] + 1, 0, 0, 0);
+                ride_over(sim, car->riders[i]);
+            }
+            log_event(LOG_CAR_UNLOADED, ev->id + 1, 0, 0, 0);
+            Attraction* a = &sim->attractions[car->attraction];
+            pthread_mutex_lock(&a->lock);
+            car_arrive(sim, ev->id);
+            pthread_mutex_unlock(&a->lock);
+            break;
+        }
+        case EV_MONITOR: {
+            ParkStats s;
+            GuestSummary g;
+            sim_snapshot(sim, &s);
+            guests_scan(&sim->guest_table, sim_now, &g);
+            print_monitor_stats(&s, &g);
+            schedule(sim, MONITOR_INTERVAL * NS_PER_SEC, EV_MONITOR, 0, 0);
+            break;
+        }
+        case EV_ARRIVAL: {
+            start_exploring(sim, admit(sim)); // only one arrival is ever pending, so this needs no lock
+            schedule_arrival(sim);
+            break;
+        }
+    }
+}
+
+void sim_free(Sim* sim) {
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        free(a->ride_queue.items);
+        free(a->car_queue.items);
+        placement_free(THREADS_PASSENGERS, a->platforms, sizeof(int) * a->cfg.platforms);
+        placement_free(THREADS_PASSENGERS, a->loading, sizeof(int) * a->cfg.platforms);
+        pthread_mutex_destroy(&a->lock);
+    }
+    placement_free(THREADS_PASSENGERS, sim->attractions, sizeof(Attraction) * sim->attractions_size);
+    for (int i = 0; i < MAX_PASSENGER_CHUNKS && sim->chunks[i]; ++i) {
+        free(sim->chunks[i]);
+    }
+    pthread_mutex_destroy(&sim->guest_lock);
+    guests_free(&sim->guest_table);
+    placement_free(THREADS_PASSENGERS, sim->cars, sizeof(Car) * (sim->num_cars > 0 ? sim->num_cars : 1));
+    free(sim->ticket_queue.items);
+    free(sim->booths);
+    free(sim->booth_stats);
+    stats_free(sim->stats);
+    pthread_mutex_destroy(&sim->ticket_lock);
+}
+
+static int init_attraction(Sim* sim, Attraction* a, const AttractionConfig* cfg) {
+    if (cfg->capacity < 1 || cfg->capacity > MAX_CAPACITY) {
+        fprintf(stderr, "%s: car capacity must be between 1 and %d\n", cfg->name, MAX_CAPACITY);
+        return -1;
+    }
+    a->cfg = *cfg;
+    if (a->cfg.platforms < 1) {
+        a->cfg.platforms = 1;
+    }
+    if (a->cfg.popularity < 1) {
+        a->cfg.popularity = 1;
+    }
+    pthread_mutex_init(&a->lock, NULL);
+    atomic_init(&a->waiting, 0);
+    atomic_init(&a->rate.last, 0);
+    atomic_init(&a->rate.gap, 0);
+    dispatch_init(&a->dispatch, &sim->cfg, a->cfg.capacity, a->cfg.wait_seconds);
+    a->first_car = sim->num_cars;
+    sim->num_cars += a->cfg.cars;
+    sim->total_popularity += a->cfg.popularity;
+    a->platforms = placement_alloc(THREADS_PASSENGERS, sizeof(int) * a->cfg.platforms);
+    a->loading = placement_alloc(THREADS_PASSENGERS, sizeof(int) * a->cfg.platforms);
+    if (!a->platforms || !a->loading ||
+        queue_init(&a->ride_queue, 0) ||
+        queue_init(&a->car_queue, a->cfg.cars)) {
+        perror("malloc");
+        return -1;
+    }
+    for (int i = 0; i < a->cfg.platforms; ++i) {
+        a->platforms[i] = -1;
+    }
+    return 0;
+}
+
+//driver fields (post, driver) are left for the caller
+//without an attraction list the park has a single ride built from the -c/-p/-w/-r/-l settings
+int sim_init(Sim* sim, const ParkConfig* cfg) {
+    memset(sim, 0, sizeof(*sim));
+    sim->cfg = *cfg;
+    sim->end = (int64_t)sim->cfg.sim_seconds * NS_PER_SEC;
+    pthread_mutex_init(&sim->ticket_lock, NULL);
+    pthread_mutex_init(&sim->guest_lock, NULL);
+    guests_init(&sim->guest_table);
+    sim->stream_stride = 1;
+    sim->stats = stats_new();
+
+    AttractionConfig single = {
+        "Ride", cfg->cars, cfg->capacity, cfg->wait_seconds, cfg->ride_seconds, cfg->platforms, 1
+    };
+    const AttractionConfig* list = cfg->num_attractions > 0 ? cfg->attractions : &single;
+    int count = cfg->num_attractions > 0 ? cfg->num_attractions : 1;
+    //the -m workers run on the --cpus-passengers list and take these far more than anything else
+    sim->attractions = placement_alloc(THREADS_PASSENGERS, sizeof(Attraction) * count);
+    sim->attractions_size = count;
+    if (!sim->attractions) {
+        perror("calloc");
+        sim_free(sim);
+        return -1;
+    }
+    for (int i = 0; i < count; ++i) {
+        sim->num_attractions++;
+        if (init_attraction(sim, &sim->attractions[i], &list[i])) {
+            sim_free(sim);
+            return -1;
+        }
+    }
+
+    sim->cars = placement_alloc(THREADS_PASSENGERS, sizeof(Car) * (sim->num_cars > 0 ? sim->num_cars : 1));
+    sim->booths = malloc(sizeof(int) * sim->cfg.booths);
+    sim->booth_stats = calloc(sim->cfg.booths, sizeof(BoothStats));
+    if (!sim->cars || !sim->booths || !sim->booth_stats ||
+        queue_init(&sim->ticket_queue, 0)) {
+        perror("malloc");
+        sim_free(sim);
+        return -1;
+    }
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        for (int c = a->first_car; c < a->first_car + a->cfg.cars; ++c) {
+            sim->cars[c].attraction = i;
+        }
+    }
+    for (int i = 0; i < sim->cfg.booths; ++i) {
+        sim->booths[i] = -1;
+    }
+    sim->free_passenger = -1;
+    rng_seed(&sim->arrival_rng, sim->cfg.seed, UINT64_MAX); // no passenger has this stream
+    sim->free_booths = sim->cfg.booths;
+    return 0;
+}
+
+static void virtual_post(Sim* sim, int64_t time, int type, int id, int gen);
+
+static int64_t virtual_time(void* ctx) {
+    Sim* sim = ctx;
+    return atomic_load_explicit(&sim->clock, memory_order_relaxed);
+}
+
+static void start_export(Sim* sim) {
+    if (!sim->quiet && EXPORT_NAME) {
+        ParkConfig cfg = sim->cfg;
+        cfg.cars = sim->num_cars;
+        //pool workers run on the real clock, which park_clock reads on any thread
+        export_start(EXPORT_NAME, EXPORT_INTERVAL_MS, sim->stats, &cfg,
+                     sim->post == virtual_post ? virtual_time : NULL, sim);
+    }
+}
+
+//first events of the day, called once at time 0
+void sim_start(Sim* sim) {
+    start_export(sim);
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        pthread_mutex_lock(&a->lock);
+        for (int c = a->first_car; c < a->first_car + a->cfg.cars; ++c) {
+            car_arrive(sim, c);
+        }
+        pthread_mutex_unlock(&a->lock);
+    }
+    for (int i = 0; i < sim->cfg.passengers; ++i) {
+        start_exploring(sim, admit(sim));
+    }
+    if (sim->cfg.arrivals) {
+        schedule_arrival(sim);
+    }
+    if (!sim->quiet) {
+        schedule(sim, MONITOR_INTERVAL * NS_PER_SEC, EV_MONITOR, 0, 0);
+    }
+}
+
+static void print_attraction_stats(Sim* sim) {
+    for (int i = 0; i < sim->num_attractions; ++i) {
+        Attraction* a = &sim->attractions[i];
+        pthread_mutex_lock(&a->lock);
+        print_attraction_stats_line(&a->cfg, a->rides, a->riders, a->ride_wait, a->ride_queue.count);
+        pthread_mutex_unlock(&a->lock);
+    }
+}
+
+void sim_finish(Sim* sim) {
+    ParkStats s;
+    for (int i = 0; i < sim->num_cars; ++i) {
+        log_event(LOG_CAR_EXITING, i + 1, 0, 0, 0);
+    }
+    log_event(LOG_SIM_ENDED, 0, 0, 0, 0);
+    log_shutdown();
+    atomic_store_explicit(&sim->clock, sim_now, memory_order_relaxed);
+    export_stop();
+    sim_snapshot(sim, &s);
+    print_final_stats(&s, &sim->cfg, sim_now / NS_PER_SEC);
+    pthread_mutex_lock(&sim->ticket_lock);
+    print_booth_stats(sim->booth_stats, sim->cfg.booths, sim_now / NS_PER_SEC);
+    pthread_mutex_unlock(&sim->ticket_lock);
+    if (sim->num_attractions > 1) {
+        print_attraction_stats(sim);
+    }
+    if (sim->cfg.arrivals) {
+        pthread_mutex_lock(&sim->guest_lock);
+        printf("Guests: %d arrived, %d left, %d in the park at closing, peak %d, %d passenger records\n",
+               sim->arrived, sim->left, sim->guests, sim->peak_guests, sim->num_records);
+        pthread_mutex_unlock(&sim->guest_lock);
+    }
+}
+
+static void virtual_post(Sim* sim, int64_t time, int type, int id, int gen) {
+    calendar_push(sim->driver, time, type, id, gen);
+}
+
+//runs from sim_now to closing time, leaves sim_now at closing time or at the check that closed the park early
+static int virtual_loop(Sim* sim, Calendar* cal) {
+    int64_t end = sim->end;
+    int64_t next_check = sim->check ? (sim_now / sim->check_interval + 1) * sim->check_interval : INT64_MAX;
+    //checks go on to closing time with nothing left on the calendar, a shard may still get guests from the others
+    while ((cal->len > 0 && cal->heap[0].time < end) || next_check < end) {
+        if (cal->len == 0 || cal->heap[0].time >= next_check) {
+            sim_now = next_check;
+            if (sim->check(sim, sim->check_ctx)) {
+                end = sim_now;
+                break;
+            }
+            next_check += sim->check_interval;
+            continue;
+        }
+        Event ev = calendar_pop(cal);
+        sim_now = ev.time;
+        atomic_store_explicit(&sim->clock, sim_now, memory_order_relaxed);
+        sim_handle(sim, &ev);
+    }
+    sim_now = end;
+    free(cal->heap);
+    return 0;
+}
+
+//runs the day on the calling thread
+int sim_run_virtual(Sim* sim) {
+    Calendar cal;
+    if (calendar_init(&cal, sim->cfg.passengers + sim->num_cars + 16)) {
+        perror("malloc");
+        return -1;
+    }
+    sim->post = virtual_post;
+    sim->driver = &cal;
+
+    sim_now = 0;
+    set_virtual_clock(&sim_now);
+    sim_start(sim);
+    return virtual_loop(sim, &cal);
+}
+
+//carries on with a day that checkpoint_read set up, sim_now and the calendar included
+int sim_resume_virtual(Sim* sim, Calendar* cal) {
+    sim->post = virtual_post;
+    sim->driver = cal;
+    set_virtual_clock(&sim_now);
+    start_export(sim);
+    return virtual_loop(sim, cal);
+}
+
+int run_virtual(const ParkConfig* cfg) {
+    Sim sim;
+    Calendar cal;
+    if (RESTORE_PATH ? checkpoint_read(&sim, &cal, RESTORE_PATH, cfg->sim_seconds) : sim_init(&sim, cfg)) {
+        return 1;
+    }
+    if (CHECKPOINT_PATH) {
+        checkpoint_enable(&sim, CHECKPOINT_PATH, CHECKPOINT_INTERVAL);
+    }
+    int err = RESTORE_PATH ? sim_resume_virtual(&sim, &cal) : sim_run_virtual(&sim);
+    checkpoint_finish();
+    if (!err) {
+        sim_finish(&sim);
+    }
+    set_virtual_clock(NULL);
+    sim_free(&sim);
+    return err ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "park.h"
+#include "stats.h"
+#include "rng.h"
+#include "hist.h"
+#include "dispatch.h"
+#include "guests.h"
+
+//event driven park model, shared by the virtual time driver (sim.c) and the worker pool driver (pool.c)
+//passengers and cars are small state records, every delay is an event handed to the driver
+
+typedef enum {
+    EV_EXPLORE_DONE,
+    EV_TICKET_DONE,
+    EV_LOAD_TIMEOUT,
+    EV_RIDE_DONE,
+    EV_MONITOR,
+    EV_ARRIVAL, // next guest through the gate, open parks only
+    EV_WALK_DONE // a guest from another shard reaches the ticket line, --shards only
+} EventType;
+
+typedef struct {
+    int64_t time; // ns since the park opened
+    uint64_t seq; // tie breaker, keeps same-time events in schedule order
+    int type;
+    int id;
+    int gen; // load timeouts are stale if the car already left
+} Event;
+
+//binary min-heap of events ordered by (time, seq)
+typedef struct {
+    Event* heap;
+    int len;
+    int size;
+    uint64_t seq;
+} Calendar;
+
+typedef enum { P_EXPLORING, P_TICKET, P_QUEUED, P_RIDING } PassengerPhase;
+
+typedef struct {
+    Rng rng;
+    int phase;
+    int booth;
+    int64_t ticket_start;
+    int64_t service_start;
+    int64_t ride_start;
+    int attraction; // chosen after exploring
+    int rides_left; // leaves when this reaches 0, -1 stays all day
+    int guest;      // arrival number, also its rng stream
+    int next_free;  // recycled records form a list
+} Passenger;
+
+//passenger records are allocated in chunks that never move, so an id stays valid while the table grows
+//a guest that leaves hands its record back, the table only grows with the guests in the park at once
+#define PASSENGER_CHUNK_BITS 12
+#define PASSENGER_CHUNK (1 << PASSENGER_CHUNK_BITS)
+#define MAX_PASSENGER_CHUNKS 4096 // 16M passengers in the park at once
+
+typedef enum { C_WAITING, C_LOADING, C_RIDING } CarPhase;
+
+typedef struct {
+    int attraction;
+    int phase;
+    int gen;
+    int platform;
+    int boarded;
+    int64_t since; // start of the current wait for a platform or of loading
+    int64_t first_ticket; // earliest ticket of the riders aboard, for the sla dispatch policy
+    int64_t deadline;     // the live load timeout, earlier ones were replaced
+    int riders[MAX_CAPACITY];
+} Car;
+
+//fixed size FIFO of ids
+typedef struct {
+    int* items;
+    int head;
+    int count;
+    int size;
+} Queue;
+
+//one ride with its own cars, platforms and lines
+//each attraction has its own lock, so boarding on one never waits for another
+typedef struct {
+    AttractionConfig cfg;
+    int first_car; // cars first_car .. first_car + cfg.cars - 1 belong here
+    pthread_mutex_t lock;
+    Queue ride_queue;   // passengers with tickets waiting for a car
+    Queue car_queue;    // cars waiting for a loading platform
+    int* platforms;     // car at each platform, -1 if free
+    int* loading;       // cars at the platforms, oldest first
+    int loading_count;
+    atomic_int waiting; // ride_queue length, read without the lock by the shortest line policy
+    int rides;
+    int riders;
+    double ride_wait;   // total ms waited for a car
+    DispatchConfig dispatch;
+    ArrivalRate rate;   // riders joining ride_queue or a loading car
+} Attraction;
+
+typedef struct Sim Sim;
+
+struct Sim {
+    ParkConfig cfg;
+    int quiet; // no monitor output, for sweeps
+    int64_t end;
+
+    //driver hook, called for every delay the model needs
+    void (*post)(Sim* sim, int64_t time, int type, int id, int gen);
+    void* driver;
+
+    //optional, the virtual driver calls it every check_interval of park time and closes early if it returns nonzero
+    int (*check)(Sim* sim, void* ctx);
+    void* check_ctx;
+    int64_t check_interval;
+
+    //optional, picks the attraction after exploring instead of -P, -1 if the guest walked to another park (shard.c)
+    int (*route)(Sim* sim, int p);
+
+    Passenger* chunks[MAX_PASSENGER_CHUNKS];
+    pthread_mutex_t guest_lock; // guards the free list and the guest counts, taken on arrival and departure only
+    int free_passenger;         // first recycled record, -1 if none
+    int num_records;            // records handed out so far
+    int guests;                 // in the park now
+    int peak_guests;
+    int arrived;
+    int left;
+    Rng arrival_rng;
+    GuestTable guest_table; // per guest figures for the monitor, one row per passenger record
+    int moved_in;           // guests that walked in from other shards
+    int moved_out;
+    int stream_stride;      // arrival number g draws from rng stream g * stream_stride + stream_offset
+    int stream_offset;
+    Car* cars;
+
+    //ticket_lock and attraction locks are never held together, nor two attraction locks
+    pthread_mutex_t ticket_lock;
+    Queue ticket_queue; // passengers waiting for a booth, one line for all booths
+    int* booths;        // passenger at each booth, -1 if free
+    int free_booths;
+    BoothStats* booth_stats;
+
+    Attraction* attractions;
+    int attractions_size; // allocated, num_attractions are set up
+    int num_attractions;
+    int total_popularity;
+    int num_cars; // over all attractions
+
+    Stats* stats; // sharded, no lock
+    atomic_llong clock; // latest event time of the virtual driver, for the export thread
+};
+
+//clock of the event being handled on this thread, ns since the park opened
+extern __thread int64_t sim_now;
+
+static inline Passenger* sim_passenger(Sim* sim, int id) {
+    return &sim->chunks[id >> PASSENGER_CHUNK_BITS][id & (PASSENGER_CHUNK - 1)];
+}
+
+int sim_init(Sim* sim, const ParkConfig* cfg);
+void sim_free(Sim* sim);
+void sim_start(Sim* sim);
+void sim_handle(Sim* sim, const Event* ev);
+void sim_snapshot(Sim* sim, ParkStats* out);
+void sim_queued_waits(Sim* sim, Histogram* out); // how long everyone in a ride line has waited so far
+//a guest walking in from another shard, it joins the ticket line of the attraction at time at
+void sim_take_guest(Sim* sim, const Passenger* state, int attraction, int rides, int64_t wait, int64_t at);
+void sim_finish(Sim* sim);
+int sim_run_virtual(Sim* sim);
+int sim_resume_virtual(Sim* sim, Calendar* cal);
+
+int calendar_init(Calendar* cal, int size);
+void calendar_push(Calendar* cal, int64_t time, int type, int id, int gen);
+Event calendar_pop(Calendar* cal);
+
+#endif
@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "stats.h"
+
+//threads are handed shards round robin the first time they count something
+static atomic_int next_shard;
+static __thread int my_shard = -1;
+
+static StatsShard* shard(Stats* stats) {
+    if (my_shard < 0) {
+        my_shard = atomic_fetch_add_explicit(&next_shard, 1, memory_order_relaxed) % STATS_SHARDS;
+    }
+    return &stats->shards[my_shard];
+}
+
+static void add(atomic_llong* counter, long long n) {
+    atomic_fetch_add_explicit(counter, n, memory_order_relaxed);
+}
+
+void stats_init(Stats* stats) {
+    for (int i = 0; i < STATS_SHARDS; ++i) {
+        StatsShard* s = &stats->shards[i];
+        atomic_init(&s->passengers_served, 0);
+        atomic_init(&s->rides_completed, 0);
+        atomic_init(&s->seats_offered, 0);
+        atomic_init(&s->ticket_wait, 0);
+        atomic_init(&s->ride_wait, 0);
+        atomic_init(&s->ticket_requests, 0);
+        atomic_init(&s->ride_requests, 0);
+        for (int m = 0; m < NUM_LATENCIES; ++m) {
+            hist_init(&s->latency[m]);
+        }
+    }
+}
+
+Stats* stats_new(void) {
+    Stats* stats = aligned_alloc(CACHE_LINE, sizeof(Stats));
+    if (!stats) {
+        perror("aligned_alloc");
+        exit(1);
+    }
+    stats_init(stats);
+    return stats;
+}
+
+void stats_free(Stats* stats) {
+    free(stats);
+}
+
+//shards past this were never handed out and are still zero
+static int used_shards(void) {
+    int n = atomic_load_explicit(&next_shard, memory_order_relaxed);
+    return n < STATS_SHARDS ? n : STATS_SHARDS;
+}
+
+void stats_ticket(Stats* stats, int64_t wait_ns) {
+    StatsShard* s = shard(stats);
+    add(&s->ticket_requests, 1);
+    add(&s->ticket_wait, wait_ns);
+    hist_record(&s->latency[LAT_TICKET_WAIT], wait_ns);
+}
+
+void stats_ride_wait(Stats* stats, int64_t wait_ns) {
+    StatsShard* s = shard(stats);
+    add(&s->ride_requests, 1);
+    add(&s->ride_wait, wait_ns);
+    hist_record(&s->latency[LAT_RIDE_WAIT], wait_ns);
+}
+
+void stats_ride(Stats* stats, int boarded, int capacity) {
+    StatsShard* s = shard(stats);
+    add(&s->rides_completed, 1);
+    add(&s->seats_offered, capacity);
+    add(&s->passengers_served, boarded);
+}
+
+void stats_latency(Stats* stats, int metric, int64_t ns) {
+    hist_record(&shard(stats)->latency[metric], ns);
+}
+
+//counters are read one at a time, so a snapshot taken mid-update may be off by one event
+void stats_read(Stats* stats, ParkStats* out) {
+    stats_read_hist(stats, out, NULL);
+}
+
+void stats_read_hist(Stats* stats, ParkStats* out, HistSnapshot* hists) {
+    long long served = 0, rides = 0, seats = 0, ticket_wait = 0, ride_wait = 0, tickets = 0, ride_requests = 0;
+    int shards = used_shards();
+    for (int i = 0; i < shards; ++i) {
+        StatsShard* s = &stats->shards[i];
+        served += atomic_load_explicit(&s->passengers_served, memory_order_relaxed);
+        rides += atomic_load_explicit(&s->rides_completed, memory_order_relaxed);
+        seats += atomic_load_explicit(&s->seats_offered, memory_order_relaxed);
+        ticket_wait += atomic_load_explicit(&s->ticket_wait, memory_order_relaxed);
+        ride_wait += atomic_load_explicit(&s->ride_wait, memory_order_relaxed);
+        tickets += atomic_load_explicit(&s->ticket_requests, memory_order_relaxed);
+        ride_requests += atomic_load_explicit(&s->ride_requests, memory_order_relaxed);
+    }
+    out->passengers_served = served;
+    out->rides_completed = rides;
+    out->seats_offered = seats;
+    out->ticket_wait = ticket_wait / 1e6;
+    out->ride_wait = ride_wait / 1e6;
+    out->ticket_requests = tickets;
+    out->ride_requests = ride_requests;
+
+    HistSnapshot local;
+    for (int m = 0; m < NUM_LATENCIES; ++m) {
+        HistSnapshot* snap = hists ? &hists[m] : &local;
+        hist_clear(snap);
+        for (int i = 0; i < shards; ++i) {
+            hist_merge(snap, &stats->shards[i].latency[m]);
+        }
+        LatencySummary* l = &out->latency[m];
+        l->p50 = hist_ms(hist_percentile(snap, 50));
+        l->p90 = hist_ms(hist_percentile(snap, 90));
+        l->p99 = hist_ms(hist_percentile(snap, 99));
+        l->p999 = hist_ms(hist_percentile(snap, 99.9));
+        l->max = snap->max / 1e6;
+    }
+}
+
+void stats_totals(Stats* stats, StatsTotals* out) {
+    ParkStats unused;
+    stats_read_hist(stats, &unused, out->latency);
+    out->passengers_served = out->rides_completed = out->seats_offered = 0;
+    out->ticket_wait = out->ride_wait = out->ticket_requests = out->ride_requests = 0;
+    int shards = used_shards();
+    for (int i = 0; i < shards; ++i) {
+        StatsShard* s = &stats->shards[i];
+        out->passengers_served += atomic_load_explicit(&s->passengers_served, memory_order_relaxed);
+        out->rides_completed += atomic_load_explicit(&s->rides_completed, memory_order_relaxed);
+        out->seats_offered += atomic_load_explicit(&s->seats_offered, memory_order_relaxed);
+        out->ticket_wait += atomic_load_explicit(&s->ticket_wait, memory_order_relaxed);
+        out->ride_wait += atomic_load_explicit(&s->ride_wait, memory_order_relaxed);
+        out->ticket_requests += atomic_load_explicit(&s->ticket_requests, memory_order_relaxed);
+        out->ride_requests += atomic_load_explicit(&s->ride_requests, memory_order_relaxed);
+    }
+}
+
+void stats_add_totals(Stats* stats, const StatsTotals* totals) {
+    StatsShard* s = shard(stats);
+    add(&s->passengers_served, totals->passengers_served);
+    add(&s->rides_completed, totals->rides_completed);
+    add(&s->seats_offered, totals->seats_offered);
+    add(&s->ticket_wait, totals->ticket_wait);
+    add(&s->ride_wait, totals->ride_wait);
+    add(&s->ticket_requests, totals->ticket_requests);
+    add(&s->ride_requests, totals->ride_requests);
+    for (int m = 0; m < NUM_LATENCIES; ++m) {
+        hist_add(&s->latency[m], &totals->latency[m]);
+    }
+}
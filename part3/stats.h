@@ -0,0 +1,59 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "park.h"
+#include "hist.h"
+
+//monitor counters split into shards, each thread adds to its own shard with relaxed atomics
+//readers add the shards up, so nothing on the hot path takes a lock just to count
+//each shard also has a latency histogram per metric, merged the same way
+
+#define STATS_SHARDS 64
+#define CACHE_LINE 64
+
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_llong passengers_served;
+    atomic_llong rides_completed;
+    atomic_llong seats_offered;
+    atomic_llong ticket_wait; // ns
+    atomic_llong ride_wait;   // ns
+    atomic_llong ticket_requests;
+    atomic_llong ride_requests;
+    Histogram latency[NUM_LATENCIES];
+} StatsShard;
+
+typedef struct {
+    StatsShard shards[STATS_SHARDS];
+} Stats;
+
+//plain sums over all shards, what a checkpoint keeps of the statistics (checkpoint.c)
+typedef struct {
+    int64_t passengers_served;
+    int64_t rides_completed;
+    int64_t seats_offered;
+    int64_t ticket_wait; // ns
+    int64_t ride_wait;   // ns
+    int64_t ticket_requests;
+    int64_t ride_requests;
+    HistSnapshot latency[NUM_LATENCIES];
+} StatsTotals;
+
+//a Stats is a few MB, stats_new puts it on the heap
+void stats_init(Stats* stats);
+Stats* stats_new(void);
+void stats_free(Stats* stats);
+void stats_ticket(Stats* stats, int64_t wait_ns);
+void stats_ride_wait(Stats* stats, int64_t wait_ns);
+void stats_ride(Stats* stats, int boarded, int capacity);
+void stats_latency(Stats* stats, int metric, int64_t ns);
+void stats_read(Stats* stats, ParkStats* out);
+//same, and hands out the merged histograms, one per LatencyMetric
+void stats_read_hist(Stats* stats, ParkStats* out, HistSnapshot* hists); // NUM_LATENCIES of them, or NULL
+//no allocation or locking, safe in a forked child
+void stats_totals(Stats* stats, StatsTotals* out);
+//adds saved totals to the calling thread's shard
+void stats_add_totals(Stats* stats, const StatsTotals* totals);
+
+#endif
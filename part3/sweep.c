@@ -0,0 +1,214 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "sim.h"
+#include "log.h"
+#include "sweep.h"
+
+//parameter sweep, runs every combination of the given settings as its own virtual time park
+//runs are independent Sim instances, spread over a pool of threads (-t, default one per core)
+//each setting takes a list and/or ranges: -c 1,2,4 or -c 1:8 or -c 2:20:2
+//replication r of every combination uses seed + r, so configurations are compared on the same random streams
+//one CSV row per run on stdout, in the order of the combinations
+
+enum { DIM_PASSENGERS, DIM_CARS, DIM_CAPACITY, DIM_WAIT, DIM_RIDE, DIM_PLATFORMS, DIM_BOOTHS, NUM_DIMS };
+
+static const char dim_option[NUM_DIMS] = { 'n', 'c', 'p', 'w', 'r', 'l', 'b' };
+
+typedef struct {
+    ParkConfig cfg;
+    int replication;
+    ParkStats stats;
+    int ok;
+} SweepRun;
+
+typedef struct {
+    SweepRun* runs;
+    int num_runs;
+    atomic_int next;
+} Sweep;
+
+void axis_add(Axis* axis, int value) {
+    axis->values = realloc(axis->values, sizeof(int) * (axis->count + 1));
+    if (!axis->values) {
+        perror("realloc");
+        exit(1);
+    }
+    axis->values[axis->count++] = value;
+}
+
+int parse_axis(Axis* axis, const char* spec) {
+    char* copy = strdup(spec);
+    char* save = NULL;
+    for (char* item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        int lo, hi, step = 1;
+        int n = sscanf(item, "%d:%d:%d", &lo, &hi, &step);
+        if (n == 1) {
+            hi = lo;
+        }
+        if (n < 1 || step < 1 || hi < lo) {
+            fprintf(stderr, "Bad sweep value '%s'\n", item);
+            free(copy);
+            return -1;
+        }
+        for (int v = lo; v <= hi; v += step) {
+            axis_add(axis, v);
+        }
+    }
+    free(copy);
+    return 0;
+}
+
+int sweep_threads(int jobs) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int num_threads = NUM_WORKERS > 0 ? NUM_WORKERS : (cores > 0 ? (int)cores : 1);
+    return num_threads < jobs ? num_threads : jobs;
+}
+
+static int get_dim(const ParkConfig* cfg, int dim) {
+    switch (dim) {
+        case DIM_PASSENGERS: return cfg->passengers;
+        case DIM_CARS: return cfg->cars;
+        case DIM_CAPACITY: return cfg->capacity;
+        case DIM_WAIT: return cfg->wait_seconds;
+        case DIM_RIDE: return cfg->ride_seconds;
+        case DIM_PLATFORMS: return cfg->platforms;
+        default: return cfg->booths;
+    }
+}
+
+static void set_dim(ParkConfig* cfg, int dim, int value) {
+    switch (dim) {
+        case DIM_PASSENGERS: cfg->passengers = value; break;
+        case DIM_CARS: cfg->cars = value; break;
+        case DIM_CAPACITY: cfg->capacity = value; break;
+        case DIM_WAIT: cfg->wait_seconds = value; break;
+        case DIM_RIDE: cfg->ride_seconds = value; break;
+        case DIM_PLATFORMS: cfg->platforms = value; break;
+        case DIM_BOOTHS: cfg->booths = value; break;
+    }
+}
+
+static void* sweep_thread(void* arg) {
+    Sweep* sweep = arg;
+    int i;
+    while ((i = atomic_fetch_add(&sweep->next, 1)) < sweep->num_runs) {
+        SweepRun* run = &sweep->runs[i];
+        Sim sim;
+        if (sim_init(&sim, &run->cfg)) {
+            continue;
+        }
+        sim.quiet = 1;
+        if (sim_run_virtual(&sim) == 0) {
+            sim_snapshot(&sim, &run->stats);
+            run->ok = 1;
+        }
+        sim_free(&sim);
+    }
+    set_virtual_clock(NULL);
+    return NULL;
+}
+
+static void print_row(const SweepRun* run) {
+    const ParkConfig* cfg = &run->cfg;
+    const ParkStats* s = &run->stats;
+    double hours = cfg->sim_seconds / 3600.0;
+    const LatencySummary* ticket = &s->latency[LAT_TICKET_WAIT];
+    const LatencySummary* ride = &s->latency[LAT_RIDE_WAIT];
+    printf("%d,%d,%d,%d,%d,%d,%d,%d,%llu,%d,%d,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%s\n",
+           cfg->passengers, cfg->cars, cfg->capacity, cfg->wait_seconds, cfg->ride_seconds,
+           cfg->platforms, cfg->booths, run->replication, (unsigned long long)cfg->seed,
+           s->rides_completed, s->passengers_served,
+           hours > 0 ? s->passengers_served / hours : 0,
+           s->seats_offered ? (100.0 * s->passengers_served) / s->seats_offered : 0,
+           s->ticket_requests ? s->ticket_wait / s->ticket_requests : 0,
+           ticket->p50, ticket->p90, ticket->p99,
+           s->ride_requests ? s->ride_wait / s->ride_requests : 0,
+           ride->p50, ride->p90, ride->p99, ride->max, dispatch_name(cfg->dispatch));
+}
+
+int run_sweep(const ParkConfig* base, const char* specs[], int replications) {
+    Axis axes[NUM_DIMS];
+    memset(axes, 0, sizeof(axes));
+    if (replications < 1) {
+        replications = 1;
+    }
+    int total = replications;
+    for (int d = 0; d < NUM_DIMS; ++d) {
+        const char* spec = specs[(int)dim_option[d]];
+        //an attraction file fixes the rides, only -n and -b can still be swept
+        if (spec && base->num_attractions > 0 && d != DIM_PASSENGERS && d != DIM_BOOTHS) {
+            fprintf(stderr, "-%c cannot be swept with -A, the rides come from the attraction file\n", dim_option[d]);
+            return 1;
+        }
+        if (spec ? parse_axis(&axes[d], spec) : 0) {
+            return 1;
+        }
+        if (axes[d].count == 0) {
+            axis_add(&axes[d], get_dim(base, d));
+        }
+        total *= axes[d].count;
+    }
+
+    Sweep sweep;
+    sweep.num_runs = total;
+    sweep.runs = calloc(total, sizeof(SweepRun));
+    atomic_init(&sweep.next, 0);
+    if (!sweep.runs) {
+        perror("calloc");
+        return 1;
+    }
+    //the last setting changes fastest, replications innermost
+    for (int i = 0; i < total; ++i) {
+        SweepRun* run = &sweep.runs[i];
+        int rest = i;
+        run->cfg = *base;
+        run->replication = rest % replications;
+        rest /= replications;
+        for (int d = NUM_DIMS - 1; d >= 0; --d) {
+            set_dim(&run->cfg, d, axes[d].values[rest % axes[d].count]);
+            rest /= axes[d].count;
+        }
+        run->cfg.seed = base->seed + run->replication;
+        if (run->cfg.platforms < 1) run->cfg.platforms = 1;
+        if (run->cfg.booths < 1) run->cfg.booths = 1;
+    }
+
+    //runs print nothing while they go, only the table at the end
+    log_level = LOG_STATS;
+    int num_threads = sweep_threads(total);
+    pthread_t* threads = malloc(sizeof(pthread_t) * num_threads);
+    if (!threads) {
+        perror("malloc");
+        exit(1);
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_create(&threads[i], NULL, sweep_thread, &sweep);
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    printf("passengers,cars,capacity,wait,ride,platforms,booths,replication,seed,rides,riders,riders_per_hour,"
+           "utilization,ticket_wait_mean_ms,ticket_wait_p50_ms,ticket_wait_p90_ms,ticket_wait_p99_ms,"
+           "ride_wait_mean_ms,ride_wait_p50_ms,ride_wait_p90_ms,ride_wait_p99_ms,ride_wait_max_ms,dispatch\n");
+    int failed = 0;
+    for (int i = 0; i < total; ++i) {
+        if (sweep.runs[i].ok) {
+            print_row(&sweep.runs[i]);
+        } else {
+            failed = 1;
+        }
+    }
+
+    free(threads);
+    free(sweep.runs);
+    for (int d = 0; d < NUM_DIMS; ++d) {
+        free(axes[d].values);
+    }
+    return failed;
+}
@@ -0,0 +1,17 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+
+//setting lists shared by --sweep (sweep.c) and --optimize (optimize.c)
+
+typedef struct {
+    int* values;
+    int count;
+} Axis;
+
+void axis_add(Axis* axis, int value);
+//"a", "a:b" or "a:b:step", comma separated, values are appended to the axis
+int parse_axis(Axis* axis, const char* spec);
+//threads for a batch of independent parks, -t or one per core, never more than jobs
+int sweep_threads(int jobs);
+
+#endif
@@ -0,0 +1,254 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+#include "timer.h"
+#include "lockprof.h"
+
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+#define WHEEL_LEVELS 4
+#define TICK_NS 1000000LL
+#define WHEEL_SPAN (1ULL << (WHEEL_BITS * WHEEL_LEVELS)) // ticks the wheel reaches ahead
+
+static Timer* slots[WHEEL_LEVELS][WHEEL_SLOTS];
+static uint64_t occupied[WHEEL_LEVELS]; // bit per non-empty slot
+static int64_t base;                    // CLOCK_MONOTONIC ns of tick 0
+static uint64_t current;                // last tick done, its timers have fired
+static uint64_t wake_tick;              // the wheel thread sleeps until this tick
+static int pending;
+static int running;
+static int closing;                     // every timer fires at once, see timer_wheel_close
+
+static pthread_mutex_t wheel_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wheel_wake; // waits on CLOCK_MONOTONIC
+static pthread_t wheel_tid;
+
+int64_t timer_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+//must hold wheel_mutex, the tick is never before current
+static void place(Timer* t, uint64_t tick) {
+    uint64_t delta = tick - current;
+    if (delta >= WHEEL_SPAN) {
+        delta = WHEEL_SPAN - 1;
+        tick = current + delta;
+    }
+    int level = 0;
+    while (delta >= (1ULL << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    int index = (tick >> (WHEEL_BITS * level)) & WHEEL_MASK;
+    t->slot = level * WHEEL_SLOTS + index;
+    t->prev = NULL;
+    t->next = slots[level][index];
+    if (t->next) {
+        t->next->prev = t;
+    }
+    slots[level][index] = t;
+    occupied[level] |= 1ULL << index;
+}
+
+//first tick at or after expires
+static uint64_t tick_of(int64_t expires) {
+    return expires <= base ? 0 : (uint64_t)((expires - base + TICK_NS - 1) / TICK_NS);
+}
+
+static Timer* take_slot(int level, int index) {
+    Timer* list = slots[level][index];
+    slots[level][index] = NULL;
+    occupied[level] &= ~(1ULL << index);
+    return list;
+}
+
+//moves one tick forward, the timers due on it go on the expired list
+static void advance(Timer** expired) {
+    current++;
+    //a level's slot is spread over the level below when that level comes round to index 0
+    for (int level = 1; level < WHEEL_LEVELS; ++level) {
+        if ((current >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) {
+            break;
+        }
+        Timer* t = take_slot(level, (current >> (WHEEL_BITS * level)) & WHEEL_MASK);
+        while (t) {
+            Timer* next = t->next;
+            uint64_t tick = tick_of(t->expires);
+            place(t, tick > current ? tick : current);
+            t = next;
+        }
+    }
+    Timer* t = take_slot(0, current & WHEEL_MASK);
+    while (t) {
+        Timer* next = t->next;
+        t->slot = -1;
+        t->fired_next = *expired;
+        *expired = t;
+        pending--;
+        t = next;
+    }
+}
+
+//every pending timer goes on the expired list, whenever it was due
+static void flush(Timer** expired) {
+    for (int level = 0; level < WHEEL_LEVELS; ++level) {
+        while (occupied[level]) {
+            Timer* t = take_slot(level, __builtin_ctzll(occupied[level]));
+            while (t) {
+                Timer* next = t->next;
+                t->slot = -1;
+                t->fired_next = *expired;
+                *expired = t;
+                pending--;
+                t = next;
+            }
+        }
+    }
+}
+
+//the next tick with anything to do: a bottom slot in this turn of the wheel, or the turn's end for the levels above
+static uint64_t next_tick(void) {
+    int index = current & WHEEL_MASK;
+    uint64_t later = index == WHEEL_MASK ? 0 : occupied[0] & (~0ULL << (index + 1));
+    if (later) {
+        return (current & ~(uint64_t)WHEEL_MASK) + __builtin_ctzll(later);
+    }
+    return (current | WHEEL_MASK) + 1;
+}
+
+static void* wheel_thread(void* arg) {
+    (void)arg;
+    prof_lock(&wheel_mutex);
+    while (running) {
+        Timer* expired = NULL;
+        if (closing) {
+            flush(&expired);
+        } else {
+            uint64_t now = (timer_now() - base) / TICK_NS; // last tick that has started
+            while (current < now) {
+                advance(&expired);
+            }
+        }
+        if (expired) {
+            //fire without the lock, a fire may add timers or take other locks
+            prof_unlock(&wheel_mutex);
+            while (expired) {
+                Timer* next = expired->fired_next;
+                expired->fire(expired);
+                expired = next;
+            }
+            prof_lock(&wheel_mutex);
+            continue;
+        }
+        if (pending == 0) {
+            wake_tick = UINT64_MAX;
+            prof_wait(&wheel_wake, &wheel_mutex);
+            continue;
+        }
+        wake_tick = next_tick();
+        int64_t at = base + (int64_t)wake_tick * TICK_NS;
+        struct timespec deadline = { at / 1000000000LL, at % 1000000000LL };
+        prof_timedwait(&wheel_wake, &wheel_mutex, &deadline);
+    }
+    prof_unlock(&wheel_mutex);
+    return NULL;
+}
+
+void timer_wheel_start(void) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&wheel_wake, &attr);
+    pthread_condattr_destroy(&attr);
+    prof_name(&wheel_mutex, "timer.mutex");
+
+    base = timer_now();
+    current = 0;
+    pending = 0;
+    running = 1;
+    closing = 0;
+    pthread_create(&wheel_tid, NULL, wheel_thread, NULL);
+}
+
+void timer_wheel_stop(void) {
+    prof_lock(&wheel_mutex);
+    running = 0;
+    pthread_cond_signal(&wheel_wake);
+    prof_unlock(&wheel_mutex);
+    pthread_join(wheel_tid, NULL);
+    pthread_cond_destroy(&wheel_wake);
+}
+
+void timer_wheel_close(void) {
+    prof_lock(&wheel_mutex);
+    closing = 1;
+    pthread_cond_signal(&wheel_wake);
+    prof_unlock(&wheel_mutex);
+}
+
+void timer_init(Timer* t, void (*fire)(Timer*)) {
+    t->fire = fire;
+    t->next = NULL;
+    t->prev = NULL;
+    t->slot = -1;
+}
+
+void timer_add(Timer* t, int64_t expires) {
+    t->expires = expires;
+    prof_lock(&wheel_mutex);
+    uint64_t tick = tick_of(expires);
+    place(t, tick > current ? tick : current + 1);
+    pending++;
+    if (tick < wake_tick || closing) {
+        pthread_cond_signal(&wheel_wake);
+    }
+    prof_unlock(&wheel_mutex);
+}
+
+int timer_cancel(Timer* t) {
+    prof_lock(&wheel_mutex);
+    int was_pending = t->slot >= 0;
+    if (was_pending) {
+        int level = t->slot / WHEEL_SLOTS;
+        int index = t->slot % WHEEL_SLOTS;
+        if (t->prev) {
+            t->prev->next = t->next;
+        } else {
+            slots[level][index] = t->next;
+        }
+        if (t->next) {
+            t->next->prev = t->prev;
+        }
+        if (!slots[level][index]) {
+            occupied[level] &= ~(1ULL << index);
+        }
+        t->slot = -1;
+        pending--;
+    }
+    prof_unlock(&wheel_mutex);
+    return was_pending;
+}
+
+typedef struct {
+    Timer timer; // first, so the timer is the sleeper
+    sem_t done;
+} Sleeper;
+
+static void wake_sleeper(Timer* t) {
+    sem_post(&((Sleeper*)t)->done);
+}
+
+void timer_sleep(int64_t ns) {
+    Sleeper s;
+    sem_init(&s.done, 0, 0);
+    timer_init(&s.timer, wake_sleeper);
+    timer_add(&s.timer, timer_now() + ns);
+    while (sem_wait(&s.done) != 0) {
+    }
+    sem_destroy(&s.done);
+}
@@ -0,0 +1,37 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+//hierarchical timer wheel on CLOCK_MONOTONIC for the threaded park
+//one wheel thread holds every explore, ticket, ride and load timeout timer and wakes only the entities whose timers expire,
+//instead of a kernel timer per sleeping thread, and a wall clock adjustment moves none of them
+//4 levels of 64 slots: 1 ms per slot at the bottom, each level up 64 times coarser, about 4.6 hours in all
+//a timer further out waits in the top level and moves down as the wheel turns
+//adding and cancelling are O(1), so is expiry apart from moving a slot down one level every 64 ticks of the level below
+
+typedef struct Timer {
+    int64_t expires;              // ns on CLOCK_MONOTONIC
+    void (*fire)(struct Timer*);  // runs on the wheel thread, the wheel lock is not held
+    struct Timer* next;
+    struct Timer* prev;
+    struct Timer* fired_next;     // expired list of the wheel thread, its owner may add it again meanwhile
+    int slot;                     // level * 64 + index, -1 when not pending
+} Timer;
+
+void timer_wheel_start(void);
+//timers still pending never fire, stop only after everything that waits on one is done
+void timer_wheel_stop(void);
+//from now on every timer fires as soon as it is added, so sleepers wake and the park shuts down without waiting out its delays
+void timer_wheel_close(void);
+
+int64_t timer_now(void);
+void timer_init(Timer* t, void (*fire)(Timer*));
+//a timer that is already due fires on the next tick
+void timer_add(Timer* t, int64_t expires);
+//returns 0 if the timer was not pending, its fire may still be running then
+int timer_cancel(Timer* t);
+//blocks the calling thread on the wheel
+void timer_sleep(int64_t ns);
+
+#endif
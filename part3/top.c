@@ -0,0 +1,178 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "export.h"
+
+//park-top, shows the live statistics a park publishes with --export
+//polls the shared memory at its own rate (-i ms), the park never notices how often or whether anyone reads
+//-q adds percentiles read from the exported histograms, -n stops after that many screens
+
+#define MAX_EXTRA 8
+
+static const char* metric_names[NUM_LATENCIES] = {
+    [LAT_TICKET_WAIT] = "Ticket wait",
+    [LAT_RIDE_WAIT] = "Ride wait",
+    [LAT_CAR_LOAD] = "Car load",
+    [LAT_CAR_IDLE] = "Car idle",
+};
+
+static const ExportSegment* open_segment(const char* name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s%s", name[0] == '/' ? "" : "/", name);
+    int fd = shm_open(path, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    const ExportSegment* seg = mmap(NULL, sizeof(ExportSegment), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED) {
+        return NULL;
+    }
+    if (memcmp(seg->magic, EXPORT_MAGIC, sizeof(seg->magic)) != 0 || seg->size != sizeof(ExportSegment)) {
+        fprintf(stderr, "%s: not a park export, or from another version\n", path);
+        exit(1);
+    }
+    return seg;
+}
+
+//seqlock read, retries while the park is in the middle of an update
+static void read_segment(const ExportSegment* seg, ExportData* out) {
+    while (1) {
+        unsigned before = atomic_load_explicit((atomic_uint*)&seg->seq, memory_order_acquire);
+        if (before & 1) {
+            sched_yield();
+            continue;
+        }
+        memcpy(out, (const void*)&seg->data, sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit((atomic_uint*)&seg->seq, memory_order_relaxed) == before) {
+            return;
+        }
+    }
+}
+
+static void show(const ExportData* d, const ExportData* prev, const double* extra, int num_extra, int clear) {
+    const ParkStats* s = &d->stats;
+    int t = d->park_time / NS_PER_SEC;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    double age = (now.tv_sec * NS_PER_SEC + now.tv_nsec - d->published) / 1e9;
+
+    if (clear) {
+        printf("\033[H\033[J");
+    }
+    printf("Park time %02d:%02d:%02d  %s  update %llu, %.1f s ago  seed %llu\n",
+           t / 3600, (t % 3600) / 60, t % 60, d->running ? "open" : "closed",
+           (unsigned long long)d->updates, age, (unsigned long long)d->seed);
+    printf("%d passengers, %d cars, %d booths\n\n", d->passengers, d->cars, d->booths);
+    printf("Passengers served: %d\n", s->passengers_served);
+    printf("Rides completed:   %d\n", s->rides_completed);
+    if (prev && d->park_time > prev->park_time) {
+        double seconds = (d->park_time - prev->park_time) / 1e9;
+        printf("Rides per second:  %.2f (park time)\n", (s->rides_completed - prev->stats.rides_completed) / seconds);
+    }
+    printf("Avg ticket wait:   %.1f ms\n", s->ticket_requests ? s->ticket_wait / s->ticket_requests : 0);
+    printf("Avg ride wait:     %.1f ms\n", s->ride_requests ? s->ride_wait / s->ride_requests : 0);
+    printf("Car utilization:   %.0f%%\n\n", s->seats_offered ? (100.0 * s->passengers_served) / s->seats_offered : 0);
+
+    printf("%-12s %10s %10s %10s %10s %10s", "ms", "p50", "p90", "p99", "p99.9", "max");
+    for (int q = 0; q < num_extra; ++q) {
+        char label[16];
+        snprintf(label, sizeof(label), "p%g", extra[q]);
+        printf(" %10s", label);
+    }
+    printf("\n");
+    for (int m = 0; m < NUM_LATENCIES; ++m) {
+        const LatencySummary* l = &s->latency[m];
+        printf("%-12s", metric_names[m]);
+        const double values[] = { l->p50, l->p90, l->p99, l->p999, l->max };
+        for (int i = 0; i < 5; ++i) {
+            printf(" ");
+            hist_print_ms(10, values[i]);
+        }
+        for (int q = 0; q < num_extra; ++q) {
+            printf(" ");
+            hist_print_ms(10, hist_ms(hist_percentile(&d->latency[m], extra[q])));
+        }
+        printf("\n");
+    }
+    if (!clear) {
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [-i ms] [-n screens] [-q percentile]... [name]\n", name);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    int interval_ms = 1000;
+    int screens = 0; // 0 runs until the park closes
+    double extra[MAX_EXTRA];
+    int num_extra = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:q:")) != -1) {
+        switch (opt) {
+            case 'i': interval_ms = atoi(optarg); break;
+            case 'n': screens = atoi(optarg); break;
+            case 'q':
+                if (num_extra < MAX_EXTRA) {
+                    extra[num_extra++] = atof(optarg);
+                }
+                break;
+            default: usage(argv[0]);
+        }
+    }
+    if (optind < argc - 1) {
+        usage(argv[0]);
+    }
+    const char* name = optind < argc ? argv[optind] : EXPORT_DEFAULT_NAME;
+    if (interval_ms < 1) {
+        interval_ms = 1;
+    }
+    struct timespec pause = { interval_ms / 1000, (interval_ms % 1000) * 1000000L };
+
+    const ExportSegment* seg;
+    int waiting = 0;
+    while (!(seg = open_segment(name))) {
+        if (!waiting) {
+            fprintf(stderr, "waiting for a park exporting to %s\n", name);
+            waiting = 1;
+        }
+        nanosleep(&pause, NULL);
+    }
+
+    //about 40 KB each, too big for the stack of a small reader
+    ExportData* data = malloc(sizeof(ExportData));
+    ExportData* prev = malloc(sizeof(ExportData));
+    if (!data || !prev) {
+        perror("malloc");
+        return 1;
+    }
+    int clear = isatty(STDOUT_FILENO);
+    int have_prev = 0;
+    for (int shown = 0; screens == 0 || shown < screens; ++shown) {
+        read_segment(seg, data);
+        show(data, have_prev ? prev : NULL, extra, num_extra, clear);
+        if (!data->running) {
+            break;
+        }
+        ExportData* swap = prev;
+        prev = data;
+        data = swap;
+        have_prev = 1;
+        nanosleep(&pause, NULL);
+    }
+    munmap((void*)seg, sizeof(ExportSegment));
+    free(data);
+    free(prev);
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+//binary event trace (--trace file), written by the log writer thread next to the text log
+//a header, then fixed size records, so a tool can mmap the file and index it directly
+//records are sorted by time within each writer batch, across batches two threads' records can swap by a few microseconds
+
+#define TRACE_MAGIC "PARKTRC1"
+
+typedef struct {
+    char magic[8];        // TRACE_MAGIC, no terminator
+    uint32_t record_size; // sizeof(TraceRecord)
+    uint32_t reserved;
+    uint64_t seed;
+} TraceHeader;
+
+//ids are 1-based, as in the text log
+typedef struct {
+    int64_t time;      // ns since the park opened
+    uint16_t type;     // LogType
+    uint16_t capacity; // seats in the car, for LOG_BOARDED and LOG_CAR_TIMEOUT
+    int32_t entity;    // passenger, or car for car events
+    int32_t car;       // car for car events and LOG_BOARDED, 0 otherwise
+    int32_t value;     // seconds exploring, booth, seats taken or platform, depending on type
+} TraceRecord;
+
+#endif